@@ -0,0 +1,219 @@
+#ifndef MOU_ASYNC_H
+#define MOU_ASYNC_H
+
+/*
+ * \brief: asynchronous evaluation with dependency tracking
+ *
+ * A task declares the memory it reads and writes. It starts on the shared
+ * thread pool once every earlier task it conflicts with has finished:
+ * read after write, write after read and write after write. Independent
+ * tasks run concurrently, and a chain of assignments forms a pipeline
+ * without blocking the caller.
+ *
+ * The expression is copied into the task, but tensors are referenced and
+ * must outlive the returned future. The exception of a failed task is
+ * reported by its own future only, its dependents still run.
+ *
+ * Example:
+ *  auto f1 = EvalAsync(b, a * 2);
+ *  auto f2 = EvalAsync(c, b + 1);  // waits for f1, the caller does not
+ *  auto f3 = EvalAsync(d, a - 1);  // may run alongside f1
+ *  f2.wait();
+ */
+
+#include "expression.h"
+#include "parallel.h"
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace mou {
+
+namespace async {
+
+/*
+ * Bytes [first, first + bytes) of some buffer
+ */
+struct Region {
+    const void* first;
+    size_t bytes;
+
+    bool Overlaps(const Region& other) const {
+        auto a = reinterpret_cast<uintptr_t>(first);
+        auto b = reinterpret_cast<uintptr_t>(other.first);
+        return bytes != 0 && other.bytes != 0 &&
+            a < b + other.bytes && b < a + bytes;
+    }
+};
+
+// region of a Tensor, a Vec or anything with Data() and Size()
+template <typename T>
+inline Region RegionOf(const T& v) {
+    return {v.Data(), v.Size() * sizeof(*v.Data())};
+}
+
+class Executor {
+ public:
+    explicit Executor(parallel::ThreadPool& pool = parallel::ThreadPool::Get())
+        : pool(pool) {}
+
+    ~Executor() {
+        Wait();
+    }
+
+    Executor(const Executor&) = delete;
+    Executor& operator = (const Executor&) = delete;
+
+    static Executor& Get() {
+        static Executor inst;
+        return inst;
+    }
+
+    /*
+     * Run `task` once all earlier tasks it conflicts with are done
+     */
+    std::shared_future<void> Submit(std::vector<Region> reads,
+                                    std::vector<Region> writes,
+                                    std::function<void()> task) {
+        auto node = std::make_shared<Node>();
+        node->reads = std::move(reads);
+        node->writes = std::move(writes);
+        node->task = std::move(task);
+        node->future = node->promise.get_future().share();
+
+        bool ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& prev : inflight) {
+                if (_conflicts(*prev, *node)) {
+                    prev->next.push_back(node);
+                    ++node->pending;
+                }
+            }
+            inflight.push_back(node);
+            node->self = std::prev(inflight.end());
+            ready = node->pending == 0;
+        }
+        auto future = node->future;
+        if (ready) _schedule(std::move(node));
+        return future;
+    }
+
+    /*
+     * Block until every submitted task is done
+     */
+    void Wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this] { return inflight.empty(); });
+    }
+
+ private:
+    struct Node {
+        std::vector<Region> reads;
+        std::vector<Region> writes;
+        std::function<void()> task;
+        std::promise<void> promise;
+        std::shared_future<void> future;
+        // guarded by the executor mutex
+        size_t pending = 0;
+        std::vector<std::shared_ptr<Node> > next;
+        std::list<std::shared_ptr<Node> >::iterator self;
+    };
+
+    static bool _overlaps(const std::vector<Region>& a,
+                          const std::vector<Region>& b) {
+        for (const auto& x : a) {
+            for (const auto& y : b) {
+                if (x.Overlaps(y)) return true;
+            }
+        }
+        return false;
+    }
+
+    // whether `node` has to wait for `prev`
+    static bool _conflicts(const Node& prev, const Node& node) {
+        return _overlaps(prev.writes, node.reads) ||
+            _overlaps(prev.writes, node.writes) ||
+            _overlaps(prev.reads, node.writes);
+    }
+
+    void _schedule(std::shared_ptr<Node> node) {
+        if (pool.NumWorkers() == 0) {
+            _run(std::move(node));
+        } else {
+            pool.Submit([this, node] { _run(node); });
+        }
+    }
+
+    void _run(std::shared_ptr<Node> node) {
+        std::exception_ptr error;
+        try {
+            node->task();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        node->task = nullptr;
+        // before the node leaves inflight, so that futures are ready once
+        // Wait() returns
+        if (error) {
+            node->promise.set_exception(error);
+        } else {
+            node->promise.set_value();
+        }
+
+        std::vector<std::shared_ptr<Node> > ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& n : node->next) {
+                if (--n->pending == 0) ready.push_back(n);
+            }
+            node->next.clear();
+            inflight.erase(node->self);
+            if (inflight.empty()) idle.notify_all();
+        }
+        for (auto& n : ready) _schedule(std::move(n));
+    }
+
+ private:
+    parallel::ThreadPool& pool;
+    std::list<std::shared_ptr<Node> > inflight;
+    std::mutex mutex;
+    std::condition_variable idle;
+};
+
+/*
+ * `dst = src` on the executor, dst is a Tensor or a Vec
+ */
+template <typename Dst, typename EType>
+std::shared_future<void> EvalAsync(Dst& dst, const expr::Exp<EType>& src,
+                                   Executor& ex = Executor::Get()) {
+    struct held {
+        expr::holder_t<EType> e;
+    };
+    std::vector<Region> reads;
+    expr::ForEachLeaf(src.self(), [&reads](const auto& leaf) {
+        reads.push_back(RegionOf(leaf));
+    });
+    return ex.Submit(std::move(reads), {RegionOf(dst)},
+                     [&dst, h = held{src.self()}] { dst = h.e; });
+}
+
+template <typename Dst, typename EType,
+          typename = typename std::enable_if_t<std::is_scalar_v<EType> > >
+std::shared_future<void> EvalAsync(Dst& dst, const EType& src,
+                                   Executor& ex = Executor::Get()) {
+    return EvalAsync(dst, expr::ScalarMapExp<EType>(src), ex);
+}
+
+}; // namespace async
+
+}; // namespace mou
+
+#endif // MOU_ASYNC_H
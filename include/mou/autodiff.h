@@ -0,0 +1,561 @@
+#ifndef MOU_AUTODIFF_H
+#define MOU_AUTODIFF_H
+
+/*
+ * \brief: reverse-mode automatic differentiation of expressions
+ *
+ * A Tape evaluates expressions over Vars and records them. Backward then
+ * walks the records in reverse; for every record a single loop visits
+ * each element once and pushes its gradient from the root of the
+ * expression down to the leaves, like the forward loop, so a chain such
+ * as tanh(w * x + b) keeps no per-node gradients.
+ *
+ * Records, results and their gradients live in an Arena owned by the
+ * tape. Reset() rewinds it, so a training step allocates nothing from
+ * the heap once the arena has grown to the size of a step. Parallel
+ * loops over large tensors still allocate their task bookkeeping.
+ *
+ * Differentiable ops: + - * / and negation, axpy, Where (no gradient
+ * for the mask) and the math ops. Plain tensors, Vecs, scalars and random
+ * leaves are constants; comparisons have no gradient. Operands of an
+ * expression have the same number of elements. Tensors used in recorded
+ * expressions must outlive Backward().
+ *
+ * Example:
+ *  autodiff::Tape tape;
+ *  auto w = tape.Param(W, dW);             // gradient added to dW
+ *  auto h = tape.Compute(F<math::tanh>(F<expr::axpy>(w, X, B)));
+ *  auto loss = tape.Sum((h - Y) * (h - Y));
+ *  tape.Backward(loss);
+ *  tape.Reset();
+ */
+
+#include "expression.h"
+#include "math.h"
+#include "parallel.h"
+#include "tensor.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mou {
+
+namespace autodiff {
+
+using tensor::Shape;
+
+// bytes of the first block of an arena
+constexpr size_t kArenaBlock = 1 << 20;
+
+/*
+ * Bump allocator handing out kSimdAlignment aligned memory. Reset()
+ * frees nothing but rewinds to the start, merging the blocks into one,
+ * so that a repeated sequence of allocations reuses the same memory.
+ */
+class Arena {
+ public:
+    explicit Arena(size_t block_bytes = kArenaBlock)
+        : block_bytes(block_bytes) {}
+
+    ~Arena() {
+        for (auto& b : blocks) _free(b.data);
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator = (const Arena&) = delete;
+
+    void* Allocate(size_t bytes, size_t align = tensor::kSimdAlignment) {
+        assert(align <= tensor::kSimdAlignment);
+        align = tensor::kSimdAlignment;
+        for (; current < blocks.size(); ++current, offset = 0) {
+            size_t first = (offset + align - 1) / align * align;
+            if (first + bytes <= blocks[current].size) {
+                offset = first + bytes;
+                return blocks[current].data + first;
+            }
+        }
+        size_t size = std::max(bytes, block_bytes);
+        blocks.push_back({_alloc(size), size});
+        offset = bytes;
+        return blocks.back().data;
+    }
+
+    // uninitialized storage for n objects of T, valid until Reset()
+    template <typename T>
+    T* Allocate(size_t n = 1) {
+        return static_cast<T*>(Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void Reset() {
+        if (blocks.size() > 1) {
+            size_t size = Capacity();
+            for (auto& b : blocks) _free(b.data);
+            blocks.clear();
+            blocks.push_back({_alloc(size), size});
+        }
+        current = 0;
+        offset = 0;
+    }
+
+    size_t Capacity() const {
+        size_t size = 0;
+        for (auto& b : blocks) size += b.size;
+        return size;
+    }
+
+ private:
+    struct block {
+        char* data;
+        size_t size;
+    };
+
+    static char* _alloc(size_t size) {
+        return static_cast<char*>(::operator new(
+            size, std::align_val_t(tensor::kSimdAlignment)));
+    }
+
+    static void _free(char* p) {
+        ::operator delete(p, std::align_val_t(tensor::kSimdAlignment));
+    }
+
+ private:
+    size_t block_bytes;
+    std::vector<block> blocks;
+    size_t current = 0;
+    size_t offset = 0;
+};
+
+/*
+ * Differentiable leaf: values, gradients of the same shape, and the
+ * shape. A Var is a small handle and expressions copy it.
+ */
+template <typename DType>
+struct Var : public expr::Exp<Var<DType> > {
+    using type = DType;
+    DType* value;
+    DType* grad;
+    const Shape* shape;
+
+    Var(DType* value, DType* grad, const Shape* shape)
+        : value(value), grad(grad), shape(shape) {}
+
+    inline DType Eval(expr::index_t i) const {
+        return value[i];
+    }
+
+    inline DType* Data() const {
+        return value;
+    }
+
+    inline DType* Grad() const {
+        return grad;
+    }
+
+    inline const Shape& Shape_() const {
+        return *shape;
+    }
+
+    inline size_t Size() const {
+        return shape->Size();
+    }
+
+    // the values as a tensor borrowing the memory of the tape
+    tensor::Tensor<DType> Value() const {
+        return tensor::Tensor<DType>(value, *shape, tensor::borrow);
+    }
+};
+
+// gradient of an operand that has none, e.g. the mask of Where
+struct _none {};
+
+/*
+ * partial<OP>::Backward(operands..., y, g) gives the gradients of the
+ * operands of OP from their values, the result y and its gradient g.
+ * Ops without a specialization are not differentiable.
+ */
+template <typename OP>
+struct partial;
+
+#define DECLARE_UNARY_GRAD(OP_NAME, GA)                                     \
+    template <typename Ths>                                                 \
+    struct partial<OP_NAME<Ths> > {                                         \
+        template <typename Ta, typename Ty, typename Tg>                    \
+        inline static auto Backward(Ta a, Ty y, Tg g) {                     \
+            (void)a; (void)y; (void)g;                                      \
+            return GA;                                                      \
+        }                                                                   \
+    };
+
+#define DECLARE_BINARY_GRAD(OP_NAME, GA, GB)                                \
+    template <typename Tlhs, typename Trhs>                                 \
+    struct partial<OP_NAME<Tlhs, Trhs> > {                                  \
+        template <typename Ta, typename Tb, typename Ty, typename Tg>       \
+        inline static auto Backward(Ta a, Tb b, Ty y, Tg g) {               \
+            (void)a; (void)b; (void)y; (void)g;                             \
+            return std::make_pair(GA, GB);                                  \
+        }                                                                   \
+    };
+
+#define DECLARE_TERNARY_GRAD(OP_NAME, GA, GB, GC)                           \
+    template <typename Tlhs, typename Tchs, typename Trhs>                  \
+    struct partial<OP_NAME<Tlhs, Tchs, Trhs> > {                            \
+        template <typename Ta, typename Tb, typename Tc, typename Ty,       \
+                  typename Tg>                                              \
+        inline static auto Backward(Ta a, Tb b, Tc c, Ty y, Tg g) {         \
+            (void)a; (void)b; (void)c; (void)y; (void)g;                    \
+            return std::make_tuple(GA, GB, GC);                             \
+        }                                                                   \
+    };
+
+// math ops in both modes, the derivative uses the mode of the op
+#define DECLARE_MATH_GRAD(OP_NAME, GA)                                      \
+    template <typename Ths, math::mode M>                                   \
+    struct partial<math::OP_NAME##_op<Ths, M> > {                           \
+        template <typename Ta, typename Ty, typename Tg>                    \
+        inline static auto Backward(Ta a, Ty y, Tg g) {                     \
+            (void)a; (void)y; (void)g;                                      \
+            return GA;                                                      \
+        }                                                                   \
+    };
+
+DECLARE_UNARY_GRAD(expr::identity, g)
+
+DECLARE_UNARY_GRAD(expr::negation, -g)
+
+DECLARE_BINARY_GRAD(expr::plus, g, g)
+
+DECLARE_BINARY_GRAD(expr::minus, g, -g)
+
+DECLARE_BINARY_GRAD(expr::mul, g * b, g * a)
+
+DECLARE_BINARY_GRAD(expr::div, g / b, -g * y / b)
+
+DECLARE_TERNARY_GRAD(expr::axpy, g * b, g * a, g)
+
+DECLARE_TERNARY_GRAD(expr::select, _none(), a ? g : Tg(0), a ? Tg(0) : g)
+
+DECLARE_BINARY_GRAD(expr::less, _none(), _none())
+
+DECLARE_BINARY_GRAD(expr::less_equal, _none(), _none())
+
+DECLARE_BINARY_GRAD(expr::greater, _none(), _none())
+
+DECLARE_BINARY_GRAD(expr::greater_equal, _none(), _none())
+
+DECLARE_BINARY_GRAD(expr::equal_to, _none(), _none())
+
+DECLARE_BINARY_GRAD(expr::not_equal_to, _none(), _none())
+
+DECLARE_BINARY_GRAD(expr::logical_and, _none(), _none())
+
+DECLARE_BINARY_GRAD(expr::logical_or, _none(), _none())
+
+DECLARE_UNARY_GRAD(expr::logical_not, _none())
+
+DECLARE_MATH_GRAD(exp, g * y)
+
+DECLARE_MATH_GRAD(log, g / a)
+
+DECLARE_MATH_GRAD(tanh, g * (1 - y * y))
+
+DECLARE_MATH_GRAD(sigmoid, g * y * (1 - y))
+
+DECLARE_MATH_GRAD(sqrt, g / (2 * y))
+
+DECLARE_MATH_GRAD(erf, g * Ty(1.12837916709551257390)
+                  * math::detail::_exp<M>(-a * a))
+
+/*
+ * Add gradient g of element i of an expression to its Vars. Other
+ * leaves are constants.
+ */
+template <typename EType, typename Tg>
+inline void _backprop(const expr::Exp<EType> &, expr::index_t, Tg) {}
+
+template <typename DType, typename Tg>
+inline void _backprop(const Var<DType> &v, expr::index_t i, Tg g);
+
+template <typename OP, typename Ths, typename Tg>
+inline void _backprop(const expr::UnaryMapExp<OP, Ths> &e, expr::index_t i,
+                      Tg g);
+
+template <typename OP, typename Tlhs, typename Trhs, typename Tg>
+inline void _backprop(const expr::BinaryMapExp<OP, Tlhs, Trhs> &e,
+                      expr::index_t i, Tg g);
+
+template <typename OP, typename Tlhs, typename Tchs, typename Trhs,
+          typename Tg>
+inline void _backprop(const expr::TernaryMapExp<OP, Tlhs, Tchs, Trhs> &e,
+                      expr::index_t i, Tg g);
+
+template <typename Fn, typename... Ts, typename Tg>
+inline void _backprop(const expr::MapExp<Fn, Ts...> &, expr::index_t, Tg);
+
+template <typename EType, typename Tg>
+inline void _backprop_to(const EType &e, expr::index_t i, Tg g) {
+    if constexpr (!std::is_same_v<Tg, _none>) _backprop(e, i, g);
+}
+
+template <typename DType, typename Tg>
+inline void _backprop(const Var<DType> &v, expr::index_t i, Tg g) {
+    v.grad[i] += static_cast<DType>(g);
+}
+
+template <typename OP, typename Ths, typename Tg>
+inline void _backprop(const expr::UnaryMapExp<OP, Ths> &e, expr::index_t i,
+                      Tg g) {
+    auto a = e.hs.Eval(i);
+    _backprop_to(e.hs, i, partial<OP>::Backward(a, OP::Map(a), g));
+}
+
+template <typename OP, typename Tlhs, typename Trhs, typename Tg>
+inline void _backprop(const expr::BinaryMapExp<OP, Tlhs, Trhs> &e,
+                      expr::index_t i, Tg g) {
+    auto a = e.lhs.Eval(i);
+    auto b = e.rhs.Eval(i);
+    auto ga = partial<OP>::Backward(a, b, OP::Map(a, b), g);
+    _backprop_to(e.lhs, i, ga.first);
+    _backprop_to(e.rhs, i, ga.second);
+}
+
+template <typename OP, typename Tlhs, typename Tchs, typename Trhs,
+          typename Tg>
+inline void _backprop(const expr::TernaryMapExp<OP, Tlhs, Tchs, Trhs> &e,
+                      expr::index_t i, Tg g) {
+    auto a = e.lhs.Eval(i);
+    auto b = e.chs.Eval(i);
+    auto c = e.rhs.Eval(i);
+    auto ga = partial<OP>::Backward(a, b, c, OP::Map(a, b, c), g);
+    _backprop_to(e.lhs, i, std::get<0>(ga));
+    _backprop_to(e.chs, i, std::get<1>(ga));
+    _backprop_to(e.rhs, i, std::get<2>(ga));
+}
+
+template <typename Fn, typename... Ts, typename Tg>
+inline void _backprop(const expr::MapExp<Fn, Ts...> &, expr::index_t, Tg) {
+    static_assert(sizeof(Fn) != sizeof(Fn),
+                  "expressions of a callable are not differentiable");
+}
+
+// f(begin, end) on the pool for large n, like tensor evaluation of
+// parallel_eval allocators
+template <typename Fn>
+inline void _parallel(size_t n, Fn&& f) {
+    const tensor::eval_params& p = tensor::EvalParams();
+    if (n < p.parallel_threshold) {
+        f(0, n);
+    } else {
+        parallel::ParallelFor(0, n, p.grain, f);
+    }
+}
+
+/*
+ * Records of a tape, chained from the last one. Records of the Arena
+ * are destroyed by hand, so they only hold what the type erasure needs.
+ */
+struct _record {
+    _record* prev = nullptr;
+    void (*backward)(const _record*) = nullptr;
+    void (*destroy)(_record*) = nullptr;
+};
+
+// out = e elementwise, or out = sum of e when kSum
+template <typename EType, typename DType, bool kSum>
+struct _exp_record : public _record {
+    EType e;
+    Shape shape;
+    size_t n;
+    Var<DType> out;
+
+    _exp_record(const EType& e, Shape _shape, size_t n, Arena& arena)
+        : e(e), shape(std::move(_shape)), n(n),
+          out(nullptr, nullptr, &shape) {
+        backward = &_backward;
+        destroy = &_destroy;
+        size_t m = shape.Size();
+        out.value = arena.Allocate<DType>(m);
+        out.grad = arena.Allocate<DType>(m);
+        std::fill(out.grad, out.grad + m, DType(0));
+    }
+
+    void Forward(Arena& arena) {
+        if constexpr (kSum) {
+            size_t grain = tensor::EvalParams().grain;
+            size_t chunks = n < tensor::EvalParams().parallel_threshold
+                ? 1 : (n + grain - 1) / grain;
+            size_t step = (n + chunks - 1) / std::max<size_t>(chunks, 1);
+            DType* sums = arena.Allocate<DType>(chunks);
+            auto sum = [this, sums, step](size_t begin, size_t end) {
+                for (size_t c = begin; c < end; ++c) {
+                    DType s = 0;
+                    size_t last = std::min(n, (c + 1) * step);
+                    for (size_t i = c * step; i < last; ++i) s += e.Eval(i);
+                    sums[c] = s;
+                }
+            };
+            if (chunks == 1) {
+                sum(0, 1);
+            } else {
+                parallel::ParallelFor(0, chunks, 1, sum);
+            }
+            DType total = 0;
+            for (size_t c = 0; c < chunks; ++c) total += sums[c];
+            out.value[0] = total;
+        } else {
+            _parallel(n, [this](size_t begin, size_t end) {
+                expr::EvalRange(out.value, e, begin, end);
+            });
+        }
+    }
+
+    static void _backward(const _record* r) {
+        auto& self = *static_cast<const _exp_record*>(r);
+        _parallel(self.n, [&self](size_t begin, size_t end) {
+            const DType* g = self.out.grad;
+            if (end <= INT32_MAX) {
+                int32_t last = static_cast<int32_t>(end);
+                for (int32_t i = static_cast<int32_t>(begin); i < last; ++i) {
+                    _backprop(self.e, i, kSum ? g[0] : g[i]);
+                }
+            } else {
+                for (size_t i = begin; i < end; ++i) {
+                    _backprop(self.e, i, kSum ? g[0] : g[i]);
+                }
+            }
+        });
+    }
+
+    static void _destroy(_record* r) {
+        static_cast<_exp_record*>(r)->~_exp_record();
+    }
+};
+
+/*
+ * Recorded computations on Vars, with memory from an arena
+ */
+class Tape {
+ public:
+    explicit Tape(size_t block_bytes = kArenaBlock) : arena(block_bytes) {}
+
+    ~Tape() {
+        _destroy_records();
+    }
+
+    Tape(const Tape&) = delete;
+    Tape& operator = (const Tape&) = delete;
+
+    // differentiable view of a tensor, its gradient is added to `grad`
+    template <typename DType, int DevType, int DevId, typename Allocator>
+    Var<DType> Param(tensor::Tensor<DType, DevType, DevId, Allocator>& value,
+                     tensor::Tensor<DType, DevType, DevId, Allocator>& grad) {
+        assert(value.Shape_() == grad.Shape_());
+        return Var<DType>(value.Data(), grad.Data(), &value.Shape_());
+    }
+
+    /*
+     * Evaluate e into a new Var with the shape of its first leaf having
+     * one, or the given shape
+     */
+    template <typename EType>
+    auto Compute(const expr::Exp<EType> &e) {
+        return Compute(e, _leaf_shape(e.self()));
+    }
+
+    template <typename EType>
+    auto Compute(const expr::Exp<EType> &e, const Shape& shape) {
+        return _record_exp<false>(e.self(), shape, shape.Size());
+    }
+
+    // sum of the elements of e, as a Var of shape (1)
+    template <typename EType>
+    auto Sum(const expr::Exp<EType> &e) {
+        const EType& self = e.self();
+        return _record_exp<true>(self, Shape(1), _leaf_shape(self).Size());
+    }
+
+    /*
+     * Gradients of everything recorded with respect to y, whose gradient
+     * is set to one. Gradients are added to those of Params.
+     */
+    template <typename DType>
+    void Backward(const Var<DType>& y) {
+        std::fill(y.grad, y.grad + y.Size(), DType(1));
+        for (const _record* r = last; r; r = r->prev) r->backward(r);
+    }
+
+    // forget the records and reuse their memory
+    void Reset() {
+        _destroy_records();
+        arena.Reset();
+    }
+
+    Arena& Arena_() {
+        return arena;
+    }
+
+ private:
+    template <bool kSum, typename EType>
+    auto _record_exp(const EType& e, const Shape& shape, size_t n) {
+        using DType = std::decay_t<typename EType::type>;
+        using record = _exp_record<EType, DType, kSum>;
+        expr::ForEachLeaf(e, [n](const auto& leaf) {
+            assert(leaf.Size() == n);
+            (void)leaf;
+            (void)n;
+        });
+        record* r = new (arena.Allocate<record>()) record(e, shape, n, arena);
+        r->Forward(arena);
+        r->prev = last;
+        last = r;
+        return r->out;
+    }
+
+    template <typename EType>
+    static Shape _leaf_shape(const EType& e) {
+        const Shape* shape = nullptr;
+        size_t n = 0;
+        bool found = false;
+        expr::ForEachLeaf(e, [&](const auto& leaf) {
+            if (found) return;
+            found = true;
+            n = leaf.Size();
+            if constexpr (_has_shape<std::decay_t<decltype(leaf)> >::value) {
+                shape = &leaf.Shape_();
+            }
+        });
+        assert(found);
+        return shape ? *shape : Shape(n);
+    }
+
+    template <typename T, typename = void>
+    struct _has_shape : std::false_type {};
+
+    template <typename T>
+    struct _has_shape<T, std::void_t<decltype(std::declval<const T&>()
+                                              .Shape_())> >
+        : std::true_type {};
+
+    void _destroy_records() {
+        while (last) {
+            _record* prev = last->prev;
+            last->destroy(last);
+            last = prev;
+        }
+    }
+
+ private:
+    Arena arena;
+    _record* last = nullptr;
+};
+
+}; // namespace autodiff
+
+}; // namespace mou
+
+#endif // MOU_AUTODIFF_H
@@ -0,0 +1,192 @@
+#ifndef MOU_AUTOTUNE_H
+#define MOU_AUTOTUNE_H
+
+/*
+ * \brief: choose kernel parameters by timing candidates, cached per host
+ *
+ * A tuned parameter is looked up by name in the cache file of the host,
+ * and only timed when it is missing. Results are appended to the file,
+ * so later processes skip the timing. Entries are lines of "name value";
+ * names should include what the best value depends on besides the host,
+ * e.g. the number of threads.
+ *
+ * Kernels of the library only tune themselves when MOU_AUTOTUNE is set
+ * to anything but 0, and use their built-in defaults otherwise. The cache
+ * is MOU_AUTOTUNE_CACHE if set, else $XDG_CACHE_HOME/mou/autotune-<host>
+ * or ~/.cache/mou/autotune-<host>. An unwritable cache only costs time.
+ *
+ * Example:
+ *  size_t block = autotune::Choose("scan.block", {1 << 14, 1 << 16},
+ *      [&](size_t b) { return autotune::Time([&] { run(b); }); });
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace mou {
+
+namespace autotune {
+
+// repetitions of a timed run, the fastest one counts
+constexpr int kRepeats = 3;
+// Crossover only switches for a speedup above timing noise
+constexpr double kMinSpeedup = 1.1;
+
+inline bool Enabled() {
+    const char* env = std::getenv("MOU_AUTOTUNE");
+    return env && *env && std::string(env) != "0";
+}
+
+/*
+ * Parameters tuned on this host, backed by the cache file
+ */
+class Cache {
+ public:
+    static Cache& Get() {
+        static Cache inst(_default_path());
+        return inst;
+    }
+
+    explicit Cache(std::string path) : path(std::move(path)) {
+        std::ifstream in(this->path);
+        std::string name;
+        size_t value;
+        while (in >> name >> value) values[name] = value;
+    }
+
+    Cache(const Cache&) = delete;
+    Cache& operator = (const Cache&) = delete;
+
+    bool Lookup(const std::string& name, size_t& value) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = values.find(name);
+        if (it == values.end()) return false;
+        value = it->second;
+        return true;
+    }
+
+    void Store(const std::string& name, size_t value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        values[name] = value;
+        _make_parent(path);
+        std::ofstream out(path, std::ios::app);
+        out << name << ' ' << value << '\n';
+    }
+
+    const std::string& Path() const {
+        return path;
+    }
+
+ private:
+    static std::string _default_path() {
+        if (const char* env = std::getenv("MOU_AUTOTUNE_CACHE")) return env;
+        char host[256] = "localhost";
+        gethostname(host, sizeof(host) - 1);
+        std::string dir;
+        if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+            dir = xdg;
+        } else if (const char* home = std::getenv("HOME")) {
+            dir = std::string(home) + "/.cache";
+        } else {
+            dir = "/tmp";
+        }
+        return dir + "/mou/autotune-" + host;
+    }
+
+    // mkdir -p of the directory of `file`
+    static void _make_parent(const std::string& file) {
+        for (size_t i = 1; i < file.size(); ++i) {
+            if (file[i] == '/') mkdir(file.substr(0, i).c_str(), 0755);
+        }
+    }
+
+ private:
+    std::string path;
+    std::map<std::string, size_t> values;
+    mutable std::mutex mutex;
+};
+
+/*
+ * Seconds taken by the fastest of `repeats` runs of f
+ */
+template <typename Fn>
+double Time(Fn&& f, int repeats = kRepeats) {
+    double best = std::numeric_limits<double>::infinity();
+    for (int r = 0; r < repeats; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> d =
+            std::chrono::steady_clock::now() - start;
+        best = std::min(best, d.count());
+    }
+    return best;
+}
+
+/*
+ * Candidate of the lowest cost(candidate), cached under `name`. A cached
+ * value that is not one of the candidates is tuned again.
+ */
+template <typename Cost>
+size_t Choose(const std::string& name, const std::vector<size_t>& candidates,
+              Cost&& cost, Cache& cache = Cache::Get()) {
+    size_t best;
+    if (cache.Lookup(name, best) &&
+        std::find(candidates.begin(), candidates.end(), best) !=
+            candidates.end()) {
+        return best;
+    }
+    double best_cost = std::numeric_limits<double>::infinity();
+    best = candidates.at(0);
+    for (size_t c : candidates) {
+        double t = cost(c);
+        if (t < best_cost) {
+            best_cost = t;
+            best = c;
+        }
+    }
+    cache.Store(name, best);
+    return best;
+}
+
+/*
+ * Smallest of the increasing `sizes` where fast(size) is kMinSpeedup
+ * times faster than slow(size), or the largest size plus one when there
+ * is none. Cached under `name`, a cached value that is neither is tuned
+ * again.
+ */
+template <typename Slow, typename Fast>
+size_t Crossover(const std::string& name, const std::vector<size_t>& sizes,
+                 Slow&& slow, Fast&& fast, Cache& cache = Cache::Get()) {
+    size_t none = sizes.empty() ? 0 : sizes.back() + 1;
+    size_t found;
+    if (cache.Lookup(name, found) &&
+        (found == none ||
+         std::find(sizes.begin(), sizes.end(), found) != sizes.end())) {
+        return found;
+    }
+    found = none;
+    for (size_t n : sizes) {
+        if (fast(n) * kMinSpeedup < slow(n)) {
+            found = n;
+            break;
+        }
+    }
+    cache.Store(name, found);
+    return found;
+}
+
+}; // namespace autotune
+
+}; // namespace mou
+
+#endif // MOU_AUTOTUNE_H
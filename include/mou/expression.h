@@ -5,19 +5,27 @@
  * \brief: refer to github.com/dmlc/mshadow
  */
 
+#include <cstddef>
+#include <cstdint>
 #include <cstdio>
+#include <tuple>
 #include <type_traits>
+#include <utility>
 
 namespace mou {
 
 namespace expr {
 
+// element index, 64-bit so that tensors may exceed 2^31 elements
+using index_t = std::ptrdiff_t;
+
 /*
  * Expression Type
  * - Scalar
  * - Unary
  * - Binary
  * - Ternary
+ * - Map, any callable over any number of operands
  */
 template <typename EType>
 struct Exp {
@@ -27,34 +35,52 @@ struct Exp {
     }
 };
 
+/*
+ * Nodes keep their operands by value, so an expression stays valid after
+ * the temporaries it was built from are gone. Types declaring
+ * `container_tag` own their memory and are kept by reference instead.
+ */
+template <typename T, typename = void>
+struct holder {
+    using type = const T;
+};
+
+template <typename T>
+struct holder<T, std::void_t<typename T::container_tag> > {
+    using type = const T&;
+};
+
+template <typename T>
+using holder_t = typename holder<T>::type;
+
 template <typename Ths>
 struct ScalarMapExp : public Exp<ScalarMapExp<Ths> > {
-    const Ths &hs;
+    const Ths hs;
     using type = Ths;
 
     explicit ScalarMapExp(const Ths &hs)
         : hs(hs) {}
-    inline auto Eval(int /*i*/) const {
+    inline auto Eval(index_t /*i*/) const {
         return hs;
     }
 };
 
 template <typename OP, typename Ths>
 struct UnaryMapExp : public Exp<UnaryMapExp<OP, Ths> > {
-    const Ths &hs;
+    holder_t<Ths> hs;
     using type = std::result_of_t<decltype(&OP::Map) (typename Ths::type)>;
 
     explicit UnaryMapExp(const Ths &hs)
         : hs(hs) {}
-    inline auto Eval(int i) const {
+    inline auto Eval(index_t i) const {
         return OP::Map(hs.Eval(i));
     }
 };
 
 template <typename OP, typename Tlhs, typename Trhs>
 struct BinaryMapExp : public Exp<BinaryMapExp<OP, Tlhs, Trhs> > {
-    const Tlhs &lhs;
-    const Trhs &rhs;
+    holder_t<Tlhs> lhs;
+    holder_t<Trhs> rhs;
     using type = std::result_of_t<decltype(&OP::Map) (
                 typename Tlhs::type, typename Trhs::type
             )>;
@@ -62,16 +88,16 @@ struct BinaryMapExp : public Exp<BinaryMapExp<OP, Tlhs, Trhs> > {
     BinaryMapExp(const Tlhs &lhs, const Trhs &rhs)
         : lhs(lhs), rhs(rhs) {}
 
-    inline auto Eval(int i) const {
+    inline auto Eval(index_t i) const {
         return OP::Map(lhs.Eval(i), rhs.Eval(i));
     }
 };
 
 template <typename OP, typename Tlhs, typename Tchs, typename Trhs>
 struct TernaryMapExp : public Exp<TernaryMapExp<OP, Tlhs, Tchs, Trhs> > {
-    const Tlhs &lhs;
-    const Tchs &chs;
-    const Trhs &rhs;
+    holder_t<Tlhs> lhs;
+    holder_t<Tchs> chs;
+    holder_t<Trhs> rhs;
     using type = std::result_of_t<decltype(&OP::Map) (
                 typename Tlhs::type, typename Tchs::type, typename Trhs::type
             )>;
@@ -79,11 +105,33 @@ struct TernaryMapExp : public Exp<TernaryMapExp<OP, Tlhs, Tchs, Trhs> > {
     TernaryMapExp(const Tlhs &lhs, const Tchs &chs, const Trhs &rhs)
         : lhs(lhs), chs(chs), rhs(rhs) {}
 
-    inline auto Eval(int i) const {
+    inline auto Eval(index_t i) const {
         return OP::Map(lhs.Eval(i), chs.Eval(i), rhs.Eval(i));
     }
 };
 
+// fn is called from worker threads when a Tensor evaluates in parallel,
+// see tensor::parallel_eval
+template <typename Fn, typename... Ts>
+struct MapExp : public Exp<MapExp<Fn, Ts...> > {
+    const Fn fn;
+    std::tuple<holder_t<Ts>...> hs;
+    using type = std::invoke_result_t<const Fn&, typename Ts::type...>;
+
+    explicit MapExp(const Fn &fn, const Ts &...hs)
+        : fn(fn), hs(hs...) {}
+
+    inline auto Eval(index_t i) const {
+        return _eval(i, std::index_sequence_for<Ts...>());
+    }
+
+ private:
+    template <size_t... I>
+    inline auto _eval(index_t i, std::index_sequence<I...>) const {
+        return fn(std::get<I>(hs).Eval(i)...);
+    }
+};
+
 /*
  * Vector
  */
@@ -96,13 +144,7 @@ struct Vec : public Exp<Vec<DType> > {
     Vec(DType *dptr, size_t len) : dptr(dptr), len(len) {} 
 
     template <typename EType>
-    inline Vec& operator = (const Exp<EType> &src) {
-        const EType &src_ = src.self();
-        for (int i = 0; i < len; ++i) {
-            dptr[i] = src_.Eval(i);
-        }
-        return *this;
-    }
+    inline Vec& operator = (const Exp<EType> &src);
 
     template <typename EType,
               typename = typename std::enable_if_t<std::is_scalar_v<EType>>>
@@ -112,11 +154,107 @@ struct Vec : public Exp<Vec<DType> > {
         return *this;
     }
 
-    inline DType Eval(int i) const {
+    inline DType Eval(index_t i) const {
         return dptr[i];
     }
+
+    inline DType* Data() const {
+        return dptr;
+    }
+
+    inline size_t Size() const {
+        return len;
+    }
 };
 
+/*
+ * dst[i] = src.Eval(i) for i in [begin, end). Ranges ending below 2^31
+ * use a 32-bit counter, which keeps hot loops vectorizable.
+ */
+template <typename DType, typename EType>
+inline void EvalRange(DType *dst, const EType &src,
+                      index_t begin, index_t end) {
+    if (end <= INT32_MAX) {
+        for (int32_t i = static_cast<int32_t>(begin); i < end; ++i) {
+            dst[i] = src.Eval(i);
+        }
+    } else {
+        for (index_t i = begin; i < end; ++i) {
+            dst[i] = src.Eval(i);
+        }
+    }
+}
+
+template <typename DType>
+template <typename EType>
+inline Vec<DType>& Vec<DType>::operator = (const Exp<EType> &src) {
+    EvalRange(dptr, src.self(), 0, static_cast<index_t>(len));
+    return *this;
+}
+
+/*
+ * dst[i] = src.Eval(i) only where mask.Eval(i) holds, other elements of
+ * dst are neither read nor written
+ */
+template <typename DType, typename MType, typename EType>
+inline void EvalRangeMasked(DType *dst, const MType &mask, const EType &src,
+                            index_t begin, index_t end) {
+    if (end <= INT32_MAX) {
+        for (int32_t i = static_cast<int32_t>(begin); i < end; ++i) {
+            if (mask.Eval(i)) dst[i] = src.Eval(i);
+        }
+    } else {
+        for (index_t i = begin; i < end; ++i) {
+            if (mask.Eval(i)) dst[i] = src.Eval(i);
+        }
+    }
+}
+
+// leaves with Data() read memory, generated values such as scalars do not
+template <typename T, typename = void>
+struct reads_memory : std::false_type {};
+
+template <typename T>
+struct reads_memory<T, std::void_t<decltype(std::declval<const T&>().Data())> >
+    : std::true_type {};
+
+/*
+ * Call `f(leaf)` on every leaf reading memory, e.g. a Vec or a Tensor,
+ * from left to right. Scalars and other generated leaves are skipped.
+ */
+template <typename EType, typename Fn>
+inline void ForEachLeaf(const Exp<EType> &e, Fn &&f) {
+    if constexpr (reads_memory<EType>::value) f(e.self());
+}
+
+template <typename Ths, typename Fn>
+inline void ForEachLeaf(const ScalarMapExp<Ths> &, Fn &&) {}
+
+template <typename OP, typename Ths, typename Fn>
+inline void ForEachLeaf(const UnaryMapExp<OP, Ths> &e, Fn &&f) {
+    ForEachLeaf(e.hs, f);
+}
+
+template <typename OP, typename Tlhs, typename Trhs, typename Fn>
+inline void ForEachLeaf(const BinaryMapExp<OP, Tlhs, Trhs> &e, Fn &&f) {
+    ForEachLeaf(e.lhs, f);
+    ForEachLeaf(e.rhs, f);
+}
+
+template <typename OP, typename Tlhs, typename Tchs, typename Trhs,
+          typename Fn>
+inline void ForEachLeaf(const TernaryMapExp<OP, Tlhs, Tchs, Trhs> &e,
+                        Fn &&f) {
+    ForEachLeaf(e.lhs, f);
+    ForEachLeaf(e.chs, f);
+    ForEachLeaf(e.rhs, f);
+}
+
+template <typename Fn, typename... Ts, typename FnLeaf>
+inline void ForEachLeaf(const MapExp<Fn, Ts...> &e, FnLeaf &&f) {
+    std::apply([&f](const auto &...hs) { (ForEachLeaf(hs, f), ...); }, e.hs);
+}
+
 /*
  * Recursively get expression
  */
@@ -148,6 +286,41 @@ F(const Exp<Tlhs> &lhs, const Exp<Tchs> &chs, const Exp<Trhs> &rhs) {
            >(lhs.self(), chs.self(), rhs.self());
 }
 
+/*
+ * fn(e1.Eval(i), ..., eN.Eval(i)) in the same loop as the rest of the
+ * expression. fn may be any callable, e.g. a capturing lambda, and is
+ * copied into the expression.
+ *
+ * Tensors whose allocator opts in to parallel evaluation run large
+ * expressions on the thread pool, so fn and the Eval of every leaf are
+ * then called concurrently for different elements: they must not write
+ * shared state without their own synchronization, and must not depend
+ * on the order of elements.
+ *
+ * Example:
+ *  D = F([k](auto a, auto b, auto c, auto d) { return a * b + c * d + k; },
+ *        A, B, C, D);
+ */
+template <typename Fn, typename... Ts,
+          typename = std::enable_if_t<(sizeof...(Ts) > 0)> >
+inline MapExp<Fn, Ts...> F(const Fn &fn, const Exp<Ts> &...hs) {
+    return MapExp<Fn, Ts...>(fn, hs.self()...);
+}
+
+/*
+ * Expression operand from an expression or a scalar
+ */
+template <typename T>
+inline const T& _operand(const Exp<T> &e) {
+    return e.self();
+}
+
+template <typename T,
+          typename = typename std::enable_if_t<std::is_scalar_v<T>>>
+inline ScalarMapExp<T> _operand(const T &v) {
+    return ScalarMapExp<T>(v);
+}
+
 /*
  * Wrapper macro for Unary Operator
  */
@@ -181,6 +354,16 @@ F(const Exp<Tlhs> &lhs, const Exp<Tchs> &chs, const Exp<Trhs> &rhs) {
         }                                                                   \
     };
 
+/*
+ * Wrapper macro for Unary Operator Symbol
+ */
+#define DECLARE_UNARY_OP_SYM(OP_NAME, OP_SYM)                               \
+    template <typename Ths>                                                 \
+    inline UnaryMapExp<OP_NAME<typename Ths::type>, Ths>                    \
+    operator OP_SYM (const Exp<Ths> &hs) {                                  \
+        return F<OP_NAME>(hs);                                              \
+    }
+
 /*
  * Wrapper macro for Binary Operator Symbol
  */
@@ -201,9 +384,7 @@ F(const Exp<Tlhs> &lhs, const Exp<Tchs> &chs, const Exp<Trhs> &rhs) {
         OP_NAME<typename ScalarMapExp<Tlhs>::type, typename Trhs::type>,    \
         ScalarMapExp<Tlhs>, Trhs>                                           \
     operator OP_SYM (const Tlhs &lhs, const Exp<Trhs> &rhs) {               \
-        static Tlhs scalar = lhs;                                           \
-        static auto expr = ScalarMapExp<Tlhs>(scalar);                      \
-        return F<OP_NAME>(expr, rhs);                                       \
+        return F<OP_NAME>(ScalarMapExp<Tlhs>(lhs), rhs);                    \
     }
 
 #define DECLARE_BINARY_OP_SYM_WITH_SCALAR_RIGHT(OP_NAME, OP_SYM)            \
@@ -213,9 +394,7 @@ F(const Exp<Tlhs> &lhs, const Exp<Tchs> &chs, const Exp<Trhs> &rhs) {
         OP_NAME<typename Tlhs::type, typename ScalarMapExp<Trhs>::type>,    \
         Tlhs, ScalarMapExp<Trhs> >                                          \
     operator OP_SYM (const Exp<Tlhs> &lhs, const Trhs &rhs) {               \
-        static Trhs scalar = rhs;                                           \
-        static auto expr = ScalarMapExp<Trhs>(scalar);                      \
-        return F<OP_NAME>(lhs, expr);                                       \
+        return F<OP_NAME>(lhs, ScalarMapExp<Trhs>(rhs));                    \
     }
 
 /*
@@ -244,12 +423,45 @@ DECLARE_BINARY_OP(div, a / b)
 
 DECLARE_BINARY_OP(mod, a % b)
 
+/*
+ * Comparison and logical Operator, evaluating to bool masks
+ * - less
+ * - less_equal
+ * - greater
+ * - greater_equal
+ * - equal_to
+ * - not_equal_to
+ * - logical_and
+ * - logical_or
+ * - logical_not
+ */
+DECLARE_BINARY_OP(less, a < b)
+
+DECLARE_BINARY_OP(less_equal, a <= b)
+
+DECLARE_BINARY_OP(greater, a > b)
+
+DECLARE_BINARY_OP(greater_equal, a >= b)
+
+DECLARE_BINARY_OP(equal_to, a == b)
+
+DECLARE_BINARY_OP(not_equal_to, a != b)
+
+DECLARE_BINARY_OP(logical_and, a && b)
+
+DECLARE_BINARY_OP(logical_or, a || b)
+
+DECLARE_UNARY_OP(logical_not, !a)
+
 /*
  * Ternary Operator
  * - axpy
+ * - select, both branches are evaluated so that it compiles to a blend
  */
 DECLARE_TERNARY_OP(axpy, a * b + c)
 
+DECLARE_TERNARY_OP(select, a ? b : c)
+
 /*
  * Wrapper for Binary Operator plus
  */
@@ -290,6 +502,70 @@ DECLARE_BINARY_OP_SYM(mod, %)
 DECLARE_BINARY_OP_SYM_WITH_SCALAR_LEFT(mod, %)
 DECLARE_BINARY_OP_SYM_WITH_SCALAR_RIGHT(mod, %)
 
+/*
+ * Wrapper for comparison and logical Operator
+ */
+#define DECLARE_BINARY_OP_SYM_ALL(OP_NAME, OP_SYM)                          \
+    DECLARE_BINARY_OP_SYM(OP_NAME, OP_SYM)                                  \
+    DECLARE_BINARY_OP_SYM_WITH_SCALAR_LEFT(OP_NAME, OP_SYM)                 \
+    DECLARE_BINARY_OP_SYM_WITH_SCALAR_RIGHT(OP_NAME, OP_SYM)
+
+DECLARE_BINARY_OP_SYM_ALL(less, <)
+DECLARE_BINARY_OP_SYM_ALL(less_equal, <=)
+DECLARE_BINARY_OP_SYM_ALL(greater, >)
+DECLARE_BINARY_OP_SYM_ALL(greater_equal, >=)
+DECLARE_BINARY_OP_SYM_ALL(equal_to, ==)
+DECLARE_BINARY_OP_SYM_ALL(not_equal_to, !=)
+DECLARE_BINARY_OP_SYM_ALL(logical_and, &&)
+DECLARE_BINARY_OP_SYM_ALL(logical_or, ||)
+
+DECLARE_UNARY_OP_SYM(logical_not, !)
+
+/*
+ * mask ? a : b elementwise, a and b are expressions or scalars
+ *
+ * Example:
+ *  D = Where(A > 0, A, 0);
+ */
+template <typename Tm, typename Ta, typename Tb>
+inline auto Where(const Exp<Tm> &mask, const Ta &a, const Tb &b) {
+    return F<select>(mask, _operand(a), _operand(b));
+}
+
+/*
+ * Assignment to the elements of dst where mask holds, dst is a Vec, a
+ * Tensor or anything with Data() and Size()
+ *
+ * Example:
+ *  Masked(D, A > B) = A - B;
+ */
+template <typename Dst, typename Tm>
+struct MaskedDst {
+    Dst &dst;
+    holder_t<Tm> mask;
+
+    MaskedDst(Dst &dst, const Tm &mask) : dst(dst), mask(mask) {}
+
+    template <typename EType>
+    inline MaskedDst& operator = (const Exp<EType> &src) {
+        EvalRangeMasked(dst.Data(), mask, src.self(), 0,
+                        static_cast<index_t>(dst.Size()));
+        return *this;
+    }
+
+    template <typename EType,
+              typename = typename std::enable_if_t<std::is_scalar_v<EType>>>
+    inline MaskedDst& operator = (const EType &src) {
+        (*this) = ScalarMapExp<EType>(src);
+        return *this;
+    }
+};
+
+template <typename Dst, typename Tm>
+inline MaskedDst<Dst, Tm> Masked(Dst &dst, const Exp<Tm> &mask) {
+    return MaskedDst<Dst, Tm>(dst, mask.self());
+}
+
 } // namespace expr
 
 } // namespace mou
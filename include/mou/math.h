@@ -0,0 +1,412 @@
+#ifndef MOU_MATH_H
+#define MOU_MATH_H
+
+/*
+ * \brief: vectorizable math ops for expressions
+ *
+ * Ops: exp, log, tanh, sigmoid, sqrt, erf, for float and double.
+ * Integer operands are computed in double.
+ *
+ * The kernels use only arithmetic, bit operations and selects, no libm
+ * calls or branches, so the evaluation loop of an expression vectorizes.
+ * Every op has an accurate mode and a fast mode with fewer polynomial
+ * terms or Newton steps, under math::fast.
+ *
+ * Maximum error in ULP, as checked by test_math.cc:
+ *
+ *              float            double
+ *           accurate  fast   accurate  fast
+ *  exp          2       64       2       2^17
+ *  log          2       64       2       2^19
+ *  tanh         3      128       3       2^18
+ *  sigmoid      3       64       3       2^17
+ *  sqrt         1      128       1       2^19
+ *  erf          3       32       3       2^14
+ *
+ * Results below the smallest normal number are only accurate to the
+ * spacing of denormals. Special values follow libm: NaN propagates,
+ * log(0) = -inf, log and sqrt of negative numbers are NaN.
+ *
+ * Example:
+ *  y = F<math::exp>(x) + 1;
+ *  y = F<math::fast::sigmoid>(x * 2);
+ */
+
+#include "expression.h"
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace mou {
+
+namespace math {
+
+enum class mode { accurate, fast };
+
+namespace detail {
+
+template <typename T>
+struct traits;
+
+template <>
+struct traits<float> {
+    using bits_t = int32_t;
+    using ubits_t = uint32_t;
+    static constexpr int kMantissaBits = 23;
+    static constexpr bits_t kBias = 127;
+    // adding it rounds to an integer held in the low mantissa bits
+    static constexpr float kShifter = 12582912.0f;  // 1.5 * 2^23
+    // ln(2) split so that k * kLn2Hi is exact
+    static constexpr float kLn2Hi = 0.693359375f;
+    static constexpr float kLn2Lo = -2.12194440e-4f;
+    static constexpr float kExpMax = 88.73f;
+    static constexpr float kExpMin = -104.0f;
+    // tanh and erf round to 1 beyond these
+    static constexpr float kTanhMax = 10.0f;
+    static constexpr float kErfMax = 4.0f;
+    static constexpr float kTinyScale = 16777216.0f;  // 2^24
+    static constexpr int kTinyScaleExp = 24;
+    static constexpr bits_t kRsqrtMagic = 0x5f375a86;
+    // indexed by mode
+    static constexpr int kExpDegree[2] = {7, 5};
+    static constexpr int kLogTerms[2] = {4, 2};
+    static constexpr int kSqrtSteps[2] = {3, 2};
+    static constexpr int kErfSmallTerms[2] = {7, 5};
+    static constexpr int kErfLargeTerms[2] = {11, 8};
+};
+
+template <>
+struct traits<double> {
+    using bits_t = int64_t;
+    using ubits_t = uint64_t;
+    static constexpr int kMantissaBits = 52;
+    static constexpr bits_t kBias = 1023;
+    static constexpr double kShifter = 6755399441055744.0;  // 1.5 * 2^52
+    static constexpr double kLn2Hi = 6.93145751953125e-1;
+    static constexpr double kLn2Lo = 1.42860682030941723212e-6;
+    static constexpr double kExpMax = 709.79;
+    static constexpr double kExpMin = -745.2;
+    static constexpr double kTanhMax = 20.0;
+    static constexpr double kErfMax = 6.0;
+    static constexpr double kTinyScale = 18014398509481984.0;  // 2^54
+    static constexpr int kTinyScaleExp = 54;
+    static constexpr bits_t kRsqrtMagic = 0x5fe6eb50c7b537a9;
+    static constexpr int kExpDegree[2] = {13, 9};
+    static constexpr int kLogTerms[2] = {9, 5};
+    static constexpr int kSqrtSteps[2] = {4, 3};
+    static constexpr int kErfSmallTerms[2] = {12, 9};
+    static constexpr int kErfLargeTerms[2] = {25, 16};
+};
+
+constexpr double kLog2e = 1.44269504088896340736;
+constexpr double kSqrt2 = 1.41421356237309504880;
+
+/*
+ * Chebyshev coefficients, the first one halved
+ * - kErfSmall: erf(x) / x over x^2 in [0, 1]
+ * - kErfLarge: erfc(x) * exp(x^2) over 1 / x in [1/6, 1]
+ */
+constexpr double kErfSmall[] = {
+    9.75476939382654118e-01, -1.42261205103713650e-01,
+    1.00355821875997963e-02, -5.76876469976748529e-04,
+    2.74199312521960603e-05, -1.10431755073445071e-06,
+    3.84887554203450361e-08, -1.18085825338754662e-09,
+    3.23342158260509067e-11, -7.99101594700454868e-13,
+    1.79907251139614556e-14, -3.71863548781869284e-16
+};
+
+constexpr double kErfLarge[] = {
+    2.74774685897952842e-01, 1.66993291193103965e-01,
+    -1.47784349082012989e-02, 4.60766004373487615e-04,
+    1.76579678354085799e-04, -5.02698406424690903e-05,
+    7.42701335560753147e-06, -3.51881121924765043e-07,
+    -1.71501128859187191e-07, 6.70662305301044663e-08,
+    -1.43165892649441682e-08, 1.75955679085374618e-09,
+    7.45212386418372210e-11, -1.15437842389328801e-10,
+    3.88734941974594486e-11, -8.50487313225281097e-12,
+    1.12723135862184691e-12, 4.32816749866691857e-14,
+    -8.42206109070211211e-14, 3.20037493124944140e-14,
+    -8.14717445034045284e-15, 1.42806536559176874e-15,
+    -8.80057897345878524e-17, -5.55405632736625222e-17,
+    3.03662993803595781e-17
+};
+
+// 1/k! for k = 0..N
+template <typename T, int N>
+struct exp_coeffs {
+    T c[N + 1];
+
+    constexpr exp_coeffs() : c{} {
+        double f = 1;
+        for (int k = 0; k <= N; ++k) {
+            if (k != 0) f *= k;
+            c[k] = static_cast<T>(1 / f);
+        }
+    }
+};
+
+// 1/(2k+1) for k = 1..N
+template <typename T, int N>
+struct log_coeffs {
+    T c[N];
+
+    constexpr log_coeffs() : c{} {
+        for (int k = 1; k <= N; ++k) {
+            c[k - 1] = static_cast<T>(1.0 / (2 * k + 1));
+        }
+    }
+};
+
+template <typename T, int N>
+constexpr exp_coeffs<T, N> kExpCoeffs{};
+
+template <typename T, int N>
+constexpr log_coeffs<T, N> kLogCoeffs{};
+
+template <typename T>
+inline typename traits<T>::bits_t _as_bits(T x) {
+    typename traits<T>::bits_t b;
+    std::memcpy(&b, &x, sizeof(x));
+    return b;
+}
+
+template <typename T>
+inline T _from_bits(typename traits<T>::bits_t b) {
+    T x;
+    std::memcpy(&x, &b, sizeof(x));
+    return x;
+}
+
+template <typename T>
+constexpr typename traits<T>::bits_t _sign_mask() {
+    return std::numeric_limits<typename traits<T>::bits_t>::min();
+}
+
+// |y| with the sign of x
+template <typename T>
+inline T _copysign(T y, T x) {
+    return _from_bits<T>((_as_bits(y) & ~_sign_mask<T>()) |
+                         (_as_bits(x) & _sign_mask<T>()));
+}
+
+template <typename T>
+inline T _abs(T x) {
+    return _from_bits<T>(_as_bits(x) & ~_sign_mask<T>());
+}
+
+// 2^n for n in the normal exponent range
+template <typename T>
+inline T _pow2(typename traits<T>::bits_t n) {
+    using tr = traits<T>;
+    auto b = static_cast<typename tr::ubits_t>(n + tr::kBias)
+        << tr::kMantissaBits;
+    return _from_bits<T>(static_cast<typename tr::bits_t>(b));
+}
+
+// exact conversion of a small integer, without int64 to double
+// conversions which have no SIMD form before AVX-512
+template <typename T>
+inline T _to_real(typename traits<T>::bits_t n) {
+    using tr = traits<T>;
+    return _from_bits<T>(_as_bits(tr::kShifter) + n) - tr::kShifter;
+}
+
+// c[First] + r * (c[First + 1] + ... + r * c[N])
+template <int First, int N, typename T, typename C>
+inline T _horner(const C& c, T r) {
+    T p = c[N];
+    for (int k = N - 1; k >= First; --k) p = p * r + c[k];
+    return p;
+}
+
+// sum of c[k] T_k(u) for k < N
+template <int N, typename T>
+inline T _clenshaw(const double* c, T u) {
+    T b1 = 0, b2 = 0;
+    for (int k = N - 1; k >= 1; --k) {
+        T b0 = static_cast<T>(c[k]) + 2 * u * b1 - b2;
+        b2 = b1;
+        b1 = b0;
+    }
+    return static_cast<T>(c[0]) + u * b1 - b2;
+}
+
+/*
+ * x = k * ln(2) + r with |r| <= ln(2) / 2, k returned as an integer
+ */
+template <typename T>
+inline T _reduce(T x, typename traits<T>::bits_t& k) {
+    using tr = traits<T>;
+    T s = x * static_cast<T>(kLog2e) + tr::kShifter;
+    k = _as_bits(s) - _as_bits(tr::kShifter);
+    T kf = s - tr::kShifter;
+    return (x - kf * tr::kLn2Hi) - kf * tr::kLn2Lo;
+}
+
+template <mode M, typename T>
+inline T _exp(T x) {
+    using tr = traits<T>;
+    constexpr int D = tr::kExpDegree[static_cast<int>(M)];
+    T xc = x > tr::kExpMax ? tr::kExpMax : x;
+    xc = xc < tr::kExpMin ? tr::kExpMin : xc;
+    typename tr::bits_t k;
+    T r = _reduce(xc, k);
+    T p = _horner<0, D>(kExpCoeffs<T, D>.c, r);
+    // two steps, so that results overflow or become denormal gracefully
+    auto k1 = k / 2;
+    return p * _pow2<T>(k1) * _pow2<T>(k - k1);
+}
+
+// exp(x) - 1 for -2 * kTanhMax <= x <= 0
+template <mode M, typename T>
+inline T _expm1_neg(T x) {
+    using tr = traits<T>;
+    constexpr int D = tr::kExpDegree[static_cast<int>(M)];
+    typename tr::bits_t k;
+    T r = _reduce(x, k);
+    T q = r * _horner<1, D>(kExpCoeffs<T, D>.c, r);
+    T two_k = _pow2<T>(k);
+    return two_k * q + (two_k - 1);
+}
+
+template <mode M, typename T>
+inline T _log(T x) {
+    using tr = traits<T>;
+    using bits_t = typename tr::bits_t;
+    constexpr int N = tr::kLogTerms[static_cast<int>(M)];
+    constexpr bits_t kMantissaMask = (bits_t(1) << tr::kMantissaBits) - 1;
+    constexpr bits_t kExpMask = (tr::kBias << 1) | 1;
+
+    bool tiny = x < std::numeric_limits<T>::min();
+    T xs = tiny ? x * tr::kTinyScale : x;
+    bits_t b = _as_bits(xs);
+    bits_t e = ((b >> tr::kMantissaBits) & kExpMask) - tr::kBias
+        - (tiny ? tr::kTinyScaleExp : 0);
+    // x = m * 2^e with m in [sqrt(1/2), sqrt(2))
+    T m = _from_bits<T>((b & kMantissaMask) | (tr::kBias << tr::kMantissaBits));
+    bool big = m > static_cast<T>(kSqrt2);
+    m = big ? m * T(0.5) : m;
+    e = big ? e + 1 : e;
+
+    // log(m) = 2 atanh(s) = 2 (s + s^3 / 3 + s^5 / 5 + ...)
+    T s = (m - 1) / (m + 1);
+    T z = s * s;
+    T s2 = s + s;
+    T lm = s2 + s2 * z * _horner<0, N - 1>(kLogCoeffs<T, N>.c, z);
+    T ef = _to_real<T>(e);
+    T y = ef * tr::kLn2Hi + (lm + ef * tr::kLn2Lo);
+
+    y = x == std::numeric_limits<T>::infinity() ? x : y;
+    y = x == 0 ? -std::numeric_limits<T>::infinity() : y;
+    y = x < 0 ? std::numeric_limits<T>::quiet_NaN() : y;
+    return x != x ? x : y;
+}
+
+template <mode M, typename T>
+inline T _tanh(T x) {
+    using tr = traits<T>;
+    T a = _abs(x);
+    a = a > tr::kTanhMax ? tr::kTanhMax : a;
+    // tanh(a) = -t / (t + 2) with t = exp(-2a) - 1
+    T t = _expm1_neg<M>(-2 * a);
+    return _copysign(-t / (t + 2), x);
+}
+
+template <mode M, typename T>
+inline T _sigmoid(T x) {
+    // exp of -|x| never overflows, e / (1 + e) keeps tiny results
+    T e = _exp<M>(-_abs(x));
+    T s = 1 / (1 + e);
+    return x < 0 ? e * s : s;
+}
+
+template <mode M, typename T>
+inline T _sqrt(T x) {
+    using tr = traits<T>;
+    constexpr int N = tr::kSqrtSteps[static_cast<int>(M)];
+    bool tiny = x < std::numeric_limits<T>::min();
+    T xs = tiny ? x * tr::kTinyScale : x;
+    // Newton steps on 1 / sqrt(x) from a bit-level estimate
+    T r = _from_bits<T>(tr::kRsqrtMagic
+                        - ((_as_bits(xs) & ~_sign_mask<T>()) >> 1));
+    for (int i = 0; i < N; ++i) {
+        r = r * (T(1.5) - T(0.5) * xs * r * r);
+    }
+    T y = xs * r;
+    if constexpr (M == mode::accurate) {
+        y = y + T(0.5) * r * (xs - y * y);
+    }
+    y = tiny ? y * _pow2<T>(-tr::kTinyScaleExp / 2) : y;
+
+    y = x == std::numeric_limits<T>::infinity() ? x : y;
+    y = x == 0 ? x : y;
+    y = x < 0 ? std::numeric_limits<T>::quiet_NaN() : y;
+    return x != x ? x : y;
+}
+
+template <mode M, typename T>
+inline T _erf(T x) {
+    using tr = traits<T>;
+    constexpr int NS = tr::kErfSmallTerms[static_cast<int>(M)];
+    constexpr int NL = tr::kErfLargeTerms[static_cast<int>(M)];
+    T a = _abs(x);
+
+    // |x| < 1
+    T w = a * a;
+    w = w > 1 ? T(1) : w;
+    T small = a * _clenshaw<NS>(kErfSmall, 2 * w - 1);
+
+    // |x| >= 1, erf = 1 - exp(-x^2) * erfcx(x)
+    T b = a < 1 ? T(1) : a;
+    b = b > tr::kErfMax ? tr::kErfMax : b;
+    T u = static_cast<T>(2.4) / b - static_cast<T>(1.4);
+    T large = 1 - _exp<M>(-b * b) * _clenshaw<NL>(kErfLarge, u);
+
+    T y = _copysign(a < 1 ? small : large, x);
+    return x != x ? x : y;
+}
+
+template <typename T>
+using real_t = std::conditional_t<std::is_same_v<T, float>, float, double>;
+
+}; // namespace detail
+
+/*
+ * Wrapper macro for math ops, OP_NAME<T> is accurate and
+ * fast::OP_NAME<T> is fast
+ */
+#define DECLARE_MATH_OP(OP_NAME, KERNEL)                                    \
+    template <typename Ths, mode M = mode::accurate>                        \
+    struct OP_NAME##_op {                                                   \
+        using real_t = detail::real_t<Ths>;                                 \
+        inline static real_t Map(real_t a) {                                \
+            return detail::KERNEL<M>(a);                                    \
+        }                                                                   \
+    };                                                                      \
+                                                                            \
+    template <typename Ths>                                                 \
+    using OP_NAME = OP_NAME##_op<Ths>;                                      \
+                                                                            \
+    namespace fast {                                                        \
+    template <typename Ths>                                                 \
+    using OP_NAME = OP_NAME##_op<Ths, mode::fast>;                          \
+    }
+
+DECLARE_MATH_OP(exp, _exp)
+
+DECLARE_MATH_OP(log, _log)
+
+DECLARE_MATH_OP(tanh, _tanh)
+
+DECLARE_MATH_OP(sigmoid, _sigmoid)
+
+DECLARE_MATH_OP(sqrt, _sqrt)
+
+DECLARE_MATH_OP(erf, _erf)
+
+}; // namespace math
+
+}; // namespace mou
+
+#endif // MOU_MATH_H
@@ -0,0 +1,463 @@
+#ifndef MOU_MEMORY_H
+#define MOU_MEMORY_H
+
+/*
+ * \brief: opt-in accounting of tensor memory
+ *
+ * Define MOU_ENABLE_MEMORY_TRACKING before including any mou header to
+ * record every tensor allocation. Without it the MOU_MEMORY_* macros
+ * expand to nothing.
+ *
+ * Bytes are accounted per device and per allocator, both the current and
+ * the peak usage. Each thread batches its counter updates and publishes
+ * them once kBatchBytes or kBatchCount is reached, so current and peak
+ * numbers seen from other threads lag by at most one batch per thread.
+ * Allocations larger than a batch are always published immediately.
+ *
+ * Live allocations are kept in a sharded registry with their shape, dtype
+ * and the tag active when they were allocated.
+ *
+ * Example:
+ *  #define MOU_ENABLE_MEMORY_TRACKING
+ *  #include "mou/tensor.h"
+ *  ...
+ *  {
+ *      MOU_MEMORY_TAG("embedding");
+ *      Tensor<float> table(Shape(1 << 20, 64));
+ *  }
+ *  memory::WriteReport(std::cout, memory::TakeSnapshot());
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#include <cstdlib>
+#endif
+
+namespace mou {
+
+namespace memory {
+
+constexpr int64_t kBatchBytes = 1 << 16;
+constexpr int kBatchCount = 64;
+constexpr size_t kMaxRecordDims = 8;
+constexpr size_t kNumShards = 16;
+
+/*
+ * Usage of a device, or of one allocator on a device
+ */
+struct PoolStats {
+    int dev_type;
+    int dev_id;
+    std::string allocator;  // empty for the device total
+    int64_t current;
+    int64_t peak;
+    uint64_t allocations;
+    uint64_t deallocations;
+};
+
+struct Record {
+    const void* ptr;
+    size_t bytes;
+    int dev_type;
+    int dev_id;
+    const char* dtype;
+    const char* tag;
+    const char* file;
+    int line;
+    size_t dims;
+    std::array<size_t, kMaxRecordDims> shape;  // first `dims` are valid
+};
+
+struct Snapshot {
+    std::vector<PoolStats> devices;
+    std::vector<PoolStats> allocators;
+    std::vector<Record> live;  // sorted by bytes, largest first
+
+    int64_t Current(int dev_type, int dev_id = 0) const {
+        for (auto& d : devices) {
+            if (d.dev_type == dev_type && d.dev_id == dev_id) return d.current;
+        }
+        return 0;
+    }
+
+    int64_t Peak(int dev_type, int dev_id = 0) const {
+        for (auto& d : devices) {
+            if (d.dev_type == dev_type && d.dev_id == dev_id) return d.peak;
+        }
+        return 0;
+    }
+};
+
+namespace detail {
+
+// mirrors tensor::device, which lives in tensor.h
+inline const char* _device_name(int dev_type) {
+    switch (dev_type) {
+        case 0  : return "cpu";
+        case 1  : return "gpu";
+        default : return "unknown";
+    }
+}
+
+inline std::string _demangle(const char* name) {
+#if defined(__GNUG__)
+    int status = 0;
+    char* res = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (status == 0 && res) {
+        std::string out(res);
+        std::free(res);
+        return out;
+    }
+#endif
+    return name;
+}
+
+struct Pool {
+    int dev_type;
+    int dev_id;
+    std::string allocator;
+    std::atomic<int64_t> current{0};
+    std::atomic<int64_t> peak{0};
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> deallocations{0};
+
+    void Publish(int64_t delta, uint64_t allocs, uint64_t frees) {
+        int64_t now = current.fetch_add(delta, std::memory_order_relaxed)
+            + delta;
+        int64_t old = peak.load(std::memory_order_relaxed);
+        while (now > old && !peak.compare_exchange_weak(
+                    old, now, std::memory_order_relaxed)) {}
+        allocations.fetch_add(allocs, std::memory_order_relaxed);
+        deallocations.fetch_add(frees, std::memory_order_relaxed);
+    }
+
+    PoolStats Load() const {
+        return PoolStats{dev_type, dev_id, allocator,
+                         current.load(std::memory_order_relaxed),
+                         peak.load(std::memory_order_relaxed),
+                         allocations.load(std::memory_order_relaxed),
+                         deallocations.load(std::memory_order_relaxed)};
+    }
+};
+
+struct Shard {
+    std::mutex mutex;
+    std::unordered_map<const void*, Record> records;
+};
+
+class Registry {
+ public:
+    static Registry& Get() {
+        static Registry inst;
+        return inst;
+    }
+
+    // pools are never destroyed, so references handed out stay valid
+    Pool& Intern(int dev_type, int dev_id, const std::string& allocator) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& p = pools[std::make_tuple(dev_type, dev_id, allocator)];
+        if (!p) {
+            p = std::make_unique<Pool>();
+            p->dev_type = dev_type;
+            p->dev_id = dev_id;
+            p->allocator = allocator;
+        }
+        return *p;
+    }
+
+    Shard& ShardOf(const void* p) {
+        auto h = reinterpret_cast<uintptr_t>(p);
+        return shards[(h >> 6) % kNumShards];
+    }
+
+    void Collect(Snapshot& snap) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& kv : pools) {
+                auto stats = kv.second->Load();
+                if (stats.allocator.empty()) snap.devices.push_back(stats);
+                else snap.allocators.push_back(stats);
+            }
+        }
+        for (auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (auto& kv : shard.records) {
+                snap.live.push_back(kv.second);
+            }
+        }
+        std::sort(snap.live.begin(), snap.live.end(),
+                  [](const Record& a, const Record& b) {
+                      return a.bytes > b.bytes;
+                  });
+    }
+
+ private:
+    std::mutex mutex;
+    std::map<std::tuple<int, int, std::string>, std::unique_ptr<Pool> > pools;
+    std::array<Shard, kNumShards> shards;
+};
+
+/*
+ * Per-thread counter deltas which have not been published yet
+ */
+struct Pending {
+    Pool* pool;
+    int64_t delta;
+    uint64_t allocs;
+    uint64_t frees;
+};
+
+struct LocalLedger {
+    std::vector<Pending> pending;
+    const char* tag = nullptr;
+    const char* file = nullptr;
+    int line = 0;
+
+    void Add(Pool& pool, int64_t delta, bool alloc) {
+        Pending* e = nullptr;
+        for (auto& p : pending) {
+            if (p.pool == &pool) {
+                e = &p;
+                break;
+            }
+        }
+        if (!e) {
+            pending.push_back(Pending{&pool, 0, 0, 0});
+            e = &pending.back();
+        }
+        e->delta += delta;
+        (alloc ? e->allocs : e->frees) += 1;
+        if (e->delta >= kBatchBytes || e->delta <= -kBatchBytes
+                || e->allocs + e->frees >= static_cast<uint64_t>(kBatchCount)) {
+            _publish(*e);
+        }
+    }
+
+    void Flush() {
+        for (auto& p : pending) _publish(p);
+    }
+
+    ~LocalLedger() {
+        Flush();
+    }
+
+ private:
+    static void _publish(Pending& p) {
+        p.pool->Publish(p.delta, p.allocs, p.frees);
+        p.delta = 0;
+        p.allocs = 0;
+        p.frees = 0;
+    }
+};
+
+inline LocalLedger& Local() {
+    // make sure the registry outlives every thread-local ledger
+    static Registry& registry = Registry::Get();
+    (void)registry;
+    thread_local LocalLedger ledger;
+    return ledger;
+}
+
+template <int DevType, int DevId>
+Pool& DevicePool() {
+    static Pool& pool = Registry::Get().Intern(DevType, DevId, "");
+    return pool;
+}
+
+template <typename Allocator, int DevType, int DevId>
+Pool& AllocatorPool() {
+    static Pool& pool = Registry::Get().Intern(
+            DevType, DevId, _demangle(typeid(Allocator).name()));
+    return pool;
+}
+
+} // namespace detail
+
+template <typename DType, typename Allocator, int DevType, int DevId,
+          typename ShapeT>
+void OnAllocate(const void* p, size_t bytes, const ShapeT& shape) {
+    if (!p) return;
+    auto& ledger = detail::Local();
+    ledger.Add(detail::DevicePool<DevType, DevId>(), bytes, true);
+    ledger.Add(detail::AllocatorPool<Allocator, DevType, DevId>(), bytes, true);
+
+    Record r;
+    r.ptr = p;
+    r.bytes = bytes;
+    r.dev_type = DevType;
+    r.dev_id = DevId;
+    r.dtype = typeid(DType).name();
+    r.tag = ledger.tag;
+    r.file = ledger.file;
+    r.line = ledger.line;
+    r.dims = 0;
+    for (auto d : shape) {
+        if (r.dims == kMaxRecordDims) break;
+        r.shape[r.dims++] = d;
+    }
+
+    auto& shard = detail::Registry::Get().ShardOf(p);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.records[p] = r;
+}
+
+template <typename DType, typename Allocator, int DevType, int DevId>
+void OnDeallocate(const void* p, size_t bytes) {
+    if (!p) return;
+    auto& ledger = detail::Local();
+    int64_t delta = -static_cast<int64_t>(bytes);
+    ledger.Add(detail::DevicePool<DevType, DevId>(), delta, false);
+    ledger.Add(detail::AllocatorPool<Allocator, DevType, DevId>(), delta, false);
+
+    auto& shard = detail::Registry::Get().ShardOf(p);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.records.erase(p);
+}
+
+/*
+ * Publish the pending counters of the calling thread
+ */
+inline void Flush() {
+    detail::Local().Flush();
+}
+
+/*
+ * Flushes the calling thread, then copies pools and live allocations
+ */
+inline Snapshot TakeSnapshot() {
+    Flush();
+    Snapshot snap;
+    detail::Registry::Get().Collect(snap);
+    return snap;
+}
+
+/*
+ * RAII tag attached to allocations made by this thread inside its scope
+ */
+class ScopedTag {
+ public:
+    ScopedTag(const char* tag, const char* file = nullptr, int line = 0)
+        : prev_tag(detail::Local().tag), prev_file(detail::Local().file),
+          prev_line(detail::Local().line) {
+        auto& ledger = detail::Local();
+        ledger.tag = tag;
+        ledger.file = file;
+        ledger.line = line;
+    }
+
+    ScopedTag(const ScopedTag&) = delete;
+    ScopedTag& operator = (const ScopedTag&) = delete;
+
+    ~ScopedTag() {
+        auto& ledger = detail::Local();
+        ledger.tag = prev_tag;
+        ledger.file = prev_file;
+        ledger.line = prev_line;
+    }
+
+ private:
+    const char* prev_tag;
+    const char* prev_file;
+    int prev_line;
+};
+
+/*
+ * Example:
+ *  cpu(0): current=4096 peak=8192 allocations=3 deallocations=1
+ *    std::allocator<float>: current=4096 peak=8192 ...
+ *  top 2 of 2 live allocations:
+ *    4096 bytes float (32,32) tag=embedding at model.cc:12
+ *  by tag:
+ *    embedding: 4096 bytes in 1 allocations
+ */
+inline void WriteReport(std::ostream& os, const Snapshot& snap,
+                        size_t top_k = 10) {
+    auto write_pool = [&os](const PoolStats& p) {
+        os << "current=" << p.current << " peak=" << p.peak
+           << " allocations=" << p.allocations
+           << " deallocations=" << p.deallocations << '\n';
+    };
+    for (auto& d : snap.devices) {
+        os << detail::_device_name(d.dev_type) << '(' << d.dev_id << "): ";
+        write_pool(d);
+        for (auto& a : snap.allocators) {
+            if (a.dev_type != d.dev_type || a.dev_id != d.dev_id) continue;
+            os << "  " << a.allocator << ": ";
+            write_pool(a);
+        }
+    }
+
+    size_t k = std::min(top_k, snap.live.size());
+    os << "top " << k << " of " << snap.live.size() << " live allocations:\n";
+    for (size_t i = 0; i < k; ++i) {
+        auto& r = snap.live[i];
+        os << "  " << r.bytes << " bytes " << detail::_demangle(r.dtype) << " (";
+        for (size_t j = 0; j < r.dims; ++j) {
+            if (j != 0) os << ',';
+            os << r.shape[j];
+        }
+        os << ") @" << detail::_device_name(r.dev_type) << '(' << r.dev_id
+           << ')';
+        if (r.tag) os << " tag=" << r.tag;
+        if (r.file) os << " at " << r.file << ':' << r.line;
+        os << '\n';
+    }
+
+    std::map<std::string, std::pair<size_t, size_t> > by_tag;
+    for (auto& r : snap.live) {
+        auto& e = by_tag[r.tag ? r.tag : "<untagged>"];
+        e.first += r.bytes;
+        e.second += 1;
+    }
+    os << "by tag:\n";
+    for (auto& kv : by_tag) {
+        os << "  " << kv.first << ": " << kv.second.first << " bytes in "
+           << kv.second.second << " allocations\n";
+    }
+}
+
+}; // namespace memory
+
+}; // namespace mou
+
+#ifdef MOU_ENABLE_MEMORY_TRACKING
+
+#define MOU_MEMORY_CONCAT_(a, b) a##b
+#define MOU_MEMORY_CONCAT(a, b) MOU_MEMORY_CONCAT_(a, b)
+
+#define MOU_MEMORY_TAG(NAME)                                                \
+    ::mou::memory::ScopedTag MOU_MEMORY_CONCAT(_mou_tag_, __LINE__)         \
+        ((NAME), __FILE__, __LINE__)
+
+#define MOU_MEMORY_ON_ALLOCATE(DTYPE, ALLOC, DEV_TYPE, DEV_ID, P, N, SHAPE) \
+    ::mou::memory::OnAllocate<DTYPE, ALLOC, DEV_TYPE, DEV_ID>(              \
+        (P), (N) * sizeof(DTYPE), (SHAPE))
+
+#define MOU_MEMORY_ON_DEALLOCATE(DTYPE, ALLOC, DEV_TYPE, DEV_ID, P, N)      \
+    ::mou::memory::OnDeallocate<DTYPE, ALLOC, DEV_TYPE, DEV_ID>(            \
+        (P), (N) * sizeof(DTYPE))
+
+#else
+
+#define MOU_MEMORY_TAG(NAME) ((void)0)
+#define MOU_MEMORY_ON_ALLOCATE(DTYPE, ALLOC, DEV_TYPE, DEV_ID, P, N, SHAPE) \
+    ((void)0)
+#define MOU_MEMORY_ON_DEALLOCATE(DTYPE, ALLOC, DEV_TYPE, DEV_ID, P, N)      \
+    ((void)0)
+
+#endif // MOU_ENABLE_MEMORY_TRACKING
+
+#endif // MOU_MEMORY_H
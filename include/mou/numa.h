@@ -0,0 +1,377 @@
+#ifndef MOU_NUMA_H
+#define MOU_NUMA_H
+
+/*
+ * \brief: NUMA-aware placement of tensor memory
+ *
+ * Placement policies
+ * - local: pages land on the node of the thread touching them first
+ * - interleave: pages are spread round-robin over all nodes
+ * - partitioned: the buffer is split like parallel::ParallelForStatic
+ *   splits its range, and part k is placed on the node worker k is pinned
+ *   to, so parallel loops over the tensor read local memory
+ *
+ * numa_allocator asks Tensor for a parallel first-touch: constructors and
+ * scalar assignment initialize part k of the tensor from worker k.
+ *
+ * On machines with a single node, or other platforms, allocation falls
+ * back to std::allocator. When the kernel refuses a policy, pages keep
+ * the default first-touch placement.
+ *
+ * Example:
+ *  using numa_tensor = Tensor<float, device::cpu, 0,
+ *                             numa::numa_allocator<float>>;
+ *  numa_tensor x(Shape(1 << 28));
+ *  x = 0;
+ */
+
+#include "parallel.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace mou {
+
+namespace numa {
+
+enum class policy { local, interleave, partitioned };
+
+constexpr size_t kMaxNodes = 64;
+// smaller allocations are not worth a dedicated mapping
+constexpr size_t kMinNumaBytes = 1 << 20;
+
+namespace detail {
+
+// mempolicy modes, see linux/mempolicy.h
+constexpr int kMpolPreferred = 1;
+constexpr int kMpolInterleave = 3;
+
+// parse a list like "0-3,8,10-11"
+inline std::vector<int> _parse_list(const std::string& s) {
+    std::vector<int> out;
+    size_t i = 0;
+    while (i < s.size()) {
+        size_t j = s.find(',', i);
+        if (j == std::string::npos) j = s.size();
+        std::string item = s.substr(i, j - i);
+        size_t dash = item.find('-');
+        try {
+            if (dash == std::string::npos) {
+                out.push_back(std::stoi(item));
+            } else {
+                int lo = std::stoi(item.substr(0, dash));
+                int hi = std::stoi(item.substr(dash + 1));
+                for (int k = lo; k <= hi; ++k) out.push_back(k);
+            }
+        } catch (...) {
+            // ignore malformed items
+        }
+        i = j + 1;
+    }
+    return out;
+}
+
+inline std::string _read_line(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+struct Topology {
+    std::vector<int> nodes;
+    std::vector<std::vector<int> > cpus;  // cpus of nodes[i]
+
+    static const Topology& Get() {
+        static Topology inst = _detect();
+        return inst;
+    }
+
+ private:
+    static Topology _detect() {
+        Topology t;
+#if defined(__linux__)
+        t.nodes = _parse_list(_read_line("/sys/devices/system/node/online"));
+        t.nodes.erase(std::remove_if(t.nodes.begin(), t.nodes.end(),
+                          [](int n) { return n < 0 || n >= (int)kMaxNodes; }),
+                      t.nodes.end());
+        for (int n : t.nodes) {
+            t.cpus.push_back(_parse_list(_read_line(
+                "/sys/devices/system/node/node" + std::to_string(n)
+                + "/cpulist")));
+        }
+#endif
+        if (t.nodes.empty()) {
+            t.nodes.push_back(0);
+            t.cpus.emplace_back();
+        }
+        return t;
+    }
+};
+
+struct Counters {
+    std::array<std::atomic<int64_t>, kMaxNodes> placed{};
+
+    static Counters& Get() {
+        static Counters inst;
+        return inst;
+    }
+};
+
+inline bool _mbind(void* p, size_t len, int mode, uint64_t mask) {
+#if defined(__linux__) && defined(SYS_mbind)
+    unsigned long m = static_cast<unsigned long>(mask);
+    return syscall(SYS_mbind, p, len, mode, &m, kMaxNodes + 1, 0) == 0;
+#else
+    (void)p; (void)len; (void)mode; (void)mask;
+    return false;
+#endif
+}
+
+inline size_t _page_size() {
+#if defined(__linux__)
+    static size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return page;
+#else
+    return 4096;
+#endif
+}
+
+} // namespace detail
+
+inline size_t NumNodes() {
+    return detail::Topology::Get().nodes.size();
+}
+
+/*
+ * Node worker k of the shared pool is pinned to
+ */
+inline int NodeOfWorker(size_t k, size_t workers) {
+    const auto& nodes = detail::Topology::Get().nodes;
+    return nodes[k * nodes.size() / std::max<size_t>(workers, 1)];
+}
+
+/*
+ * Pin the workers of the shared pool to the cpus of NodeOfWorker, once.
+ * Does nothing on a single node or when called from a worker.
+ */
+inline void PinWorkers() {
+#if defined(__linux__)
+    static std::once_flag once;
+    if (NumNodes() <= 1 || parallel::ThreadPool::WorkerIndex() >= 0) return;
+    std::call_once(once, [] {
+        auto& pool = parallel::ThreadPool::Get();
+        const auto& topo = detail::Topology::Get();
+        size_t workers = pool.NumWorkers();
+        pool.OnEachWorker([&](size_t k) {
+            int node = NodeOfWorker(k, workers);
+            size_t idx = std::find(topo.nodes.begin(), topo.nodes.end(), node)
+                - topo.nodes.begin();
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : topo.cpus[idx]) {
+                if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+            }
+            if (CPU_COUNT(&set) > 0) sched_setaffinity(0, sizeof(set), &set);
+        });
+    });
+#endif
+}
+
+/*
+ * Bytes of [p, p + bytes) in each part of a partitioned placement,
+ * matching parallel::StaticPartition over elements of size `elem`
+ */
+template <typename Fn>
+void ForEachPart(void* p, size_t bytes, size_t elem, Fn&& f) {
+    size_t workers = std::max<size_t>(
+            parallel::ThreadPool::Get().NumWorkers(), 1);
+    size_t page = detail::_page_size();
+    size_t n = bytes / elem;
+    auto base = reinterpret_cast<uintptr_t>(p);
+    for (size_t k = 0; k < workers; ++k) {
+        auto range = parallel::StaticPartition(0, n, k, workers);
+        // pages go to the part owning their first byte
+        uintptr_t b = (base + range.first * elem + page - 1) / page * page;
+        uintptr_t e = k + 1 == workers ? base + bytes
+            : (base + range.second * elem + page - 1) / page * page;
+        if (k == 0) b = base;
+        b = std::min<uintptr_t>(b, base + bytes);
+        e = std::min<uintptr_t>(e, base + bytes);
+        if (b < e) f(k, reinterpret_cast<void*>(b), e - b, workers);
+    }
+}
+
+/*
+ * Apply a placement policy to pages that were not touched yet, returns
+ * false if the kernel refused it. The bytes requested on each node are
+ * added to NodeBytes() either way.
+ */
+inline bool Place(void* p, size_t bytes, policy pol, size_t elem = 1) {
+    const auto& nodes = detail::Topology::Get().nodes;
+    auto& placed = detail::Counters::Get().placed;
+    switch (pol) {
+        case policy::local:
+            return true;
+        case policy::interleave: {
+            uint64_t mask = 0;
+            for (int n : nodes) mask |= uint64_t(1) << n;
+            for (int n : nodes) placed[n] += bytes / nodes.size();
+            return detail::_mbind(p, bytes, detail::kMpolInterleave, mask);
+        }
+        case policy::partitioned: {
+            PinWorkers();
+            bool ok = true;
+            ForEachPart(p, bytes, elem,
+                        [&](size_t k, void* b, size_t len, size_t workers) {
+                int node = NodeOfWorker(k, workers);
+                placed[node] += len;
+                ok &= detail::_mbind(b, len, detail::kMpolPreferred,
+                                     uint64_t(1) << node);
+            });
+            return ok;
+        }
+    }
+    return false;
+}
+
+/*
+ * Bytes currently requested on each node by Place, indexed by node id
+ */
+inline std::vector<int64_t> NodeBytes() {
+    auto& placed = detail::Counters::Get().placed;
+    std::vector<int64_t> out;
+    for (int n : detail::Topology::Get().nodes) {
+        out.resize(n + 1);
+        out[n] = placed[n].load(std::memory_order_relaxed);
+    }
+    return out;
+}
+
+/*
+ * Resident pages of [p, p + bytes) on each node, indexed by node id.
+ * Pages that were never touched are not counted.
+ */
+inline std::vector<size_t> ResidentPages(const void* p, size_t bytes) {
+    std::vector<size_t> out(detail::Topology::Get().nodes.back() + 1);
+#if defined(__linux__) && defined(SYS_move_pages)
+    size_t page = detail::_page_size();
+    auto first = reinterpret_cast<uintptr_t>(p) / page * page;
+    auto last = reinterpret_cast<uintptr_t>(p) + bytes;
+    std::vector<void*> pages;
+    for (uintptr_t a = first; a < last; a += page) {
+        pages.push_back(reinterpret_cast<void*>(a));
+    }
+    std::vector<int> status(pages.size(), -1);
+    if (!pages.empty() && syscall(SYS_move_pages, 0, pages.size(),
+                                  pages.data(), nullptr, status.data(),
+                                  0) == 0) {
+        for (int s : status) {
+            if (s >= 0 && static_cast<size_t>(s) < out.size()) ++out[s];
+        }
+    }
+#else
+    (void)p; (void)bytes;
+#endif
+    return out;
+}
+
+/*
+ * Allocator placing large buffers with a NUMA policy
+ */
+template <typename T, policy P = policy::partitioned>
+class numa_allocator {
+ public:
+    using value_type = T;
+    using pointer = T*;
+    using size_type = size_t;
+    static constexpr bool parallel_first_touch = true;
+
+    template <typename U>
+    struct rebind {
+        using other = numa_allocator<U, P>;
+    };
+
+    numa_allocator() noexcept = default;
+
+    template <typename U>
+    numa_allocator(const numa_allocator<U, P>&) noexcept {}
+
+    pointer allocate(size_type n) {
+        size_t bytes = n * sizeof(T);
+        if (!_mapped(bytes)) return std::allocator<T>().allocate(n);
+#if defined(__linux__)
+        void* p = mmap(nullptr, _round(bytes), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) throw std::bad_alloc();
+        Place(p, _round(bytes), P, sizeof(T));
+        return static_cast<pointer>(p);
+#else
+        return std::allocator<T>().allocate(n);
+#endif
+    }
+
+    void deallocate(pointer p, size_type n) noexcept {
+        size_t bytes = n * sizeof(T);
+        if (!_mapped(bytes)) return std::allocator<T>().deallocate(p, n);
+#if defined(__linux__)
+        _unplace(p, _round(bytes));
+        munmap(p, _round(bytes));
+#endif
+    }
+
+    friend bool operator == (const numa_allocator&, const numa_allocator&) {
+        return true;
+    }
+
+    friend bool operator != (const numa_allocator&, const numa_allocator&) {
+        return false;
+    }
+
+ private:
+    static bool _mapped(size_t bytes) {
+#if defined(__linux__)
+        return NumNodes() > 1 && bytes >= kMinNumaBytes;
+#else
+        (void)bytes;
+        return false;
+#endif
+    }
+
+    static size_t _round(size_t bytes) {
+        size_t page = detail::_page_size();
+        return (bytes + page - 1) / page * page;
+    }
+
+    static void _unplace(void* p, size_t bytes) {
+        const auto& nodes = detail::Topology::Get().nodes;
+        auto& placed = detail::Counters::Get().placed;
+        if (P == policy::interleave) {
+            for (int n : nodes) placed[n] -= bytes / nodes.size();
+        } else if (P == policy::partitioned) {
+            ForEachPart(p, bytes, sizeof(T),
+                        [&](size_t k, void*, size_t len, size_t workers) {
+                placed[NodeOfWorker(k, workers)] -= len;
+            });
+        }
+    }
+};
+
+}; // namespace numa
+
+}; // namespace mou
+
+#endif // MOU_NUMA_H
@@ -0,0 +1,283 @@
+#ifndef MOU_PARALLEL_H
+#define MOU_PARALLEL_H
+
+/*
+ * \brief: shared thread pool and parallel loops
+ *
+ * The pool size is std::thread::hardware_concurrency(), or MOU_NUM_THREADS
+ * when that environment variable is set.
+ *
+ * Example:
+ *  parallel::ParallelFor(0, n, 4096, [&](size_t begin, size_t end) {
+ *      for (size_t i = begin; i < end; ++i) y[i] = a * x[i] + y[i];
+ *  });
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mou {
+
+namespace parallel {
+
+class ThreadPool {
+ public:
+    explicit ThreadPool(size_t n) : affine(n) {
+        for (size_t i = 0; i < n; ++i) {
+            workers.emplace_back([this, i] { _run(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cv.notify_all();
+        for (auto& w : workers) w.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator = (const ThreadPool&) = delete;
+
+    static ThreadPool& Get() {
+        static ThreadPool inst(_default_size());
+        return inst;
+    }
+
+    inline size_t NumWorkers() const {
+        return workers.size();
+    }
+
+    /*
+     * Index of the calling worker in its pool, -1 for other threads
+     */
+    static int WorkerIndex() {
+        return _worker_index();
+    }
+
+    // run by any worker
+    void Submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            shared.push_back(std::move(task));
+        }
+        cv.notify_one();
+    }
+
+    // run by worker `w` only
+    void SubmitTo(size_t w, std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            affine[w % affine.size()].push_back(std::move(task));
+        }
+        cv.notify_all();
+    }
+
+    /*
+     * Run `f(i)` on every worker i before it takes any other task,
+     * e.g. to pin workers to cpus. Blocks until all of them ran it.
+     */
+    void OnEachWorker(const std::function<void(size_t)>& f) {
+        std::mutex m;
+        std::condition_variable done_cv;
+        size_t done = 0;
+        for (size_t i = 0; i < NumWorkers(); ++i) {
+            SubmitTo(i, [&, i] {
+                f(i);
+                std::lock_guard<std::mutex> lock(m);
+                if (++done == NumWorkers()) done_cv.notify_one();
+            });
+        }
+        std::unique_lock<std::mutex> lock(m);
+        done_cv.wait(lock, [&] { return done == NumWorkers(); });
+    }
+
+ private:
+    static size_t _default_size() {
+        if (const char* env = std::getenv("MOU_NUM_THREADS")) {
+            long n = std::atol(env);
+            if (n > 0) return static_cast<size_t>(n);
+        }
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    static int& _worker_index() {
+        thread_local int index = -1;
+        return index;
+    }
+
+    void _run(size_t i) {
+        _worker_index() = static_cast<int>(i);
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this, i] {
+                    return stop || !affine[i].empty() || !shared.empty();
+                });
+                if (!affine[i].empty()) {
+                    task = std::move(affine[i].front());
+                    affine[i].pop_front();
+                } else if (!shared.empty()) {
+                    task = std::move(shared.front());
+                    shared.pop_front();
+                } else {
+                    return;
+                }
+            }
+            task();
+        }
+    }
+
+ private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()> > shared;
+    std::vector<std::deque<std::function<void()> > > affine;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stop = false;
+};
+
+namespace detail {
+
+struct LoopState {
+    size_t first;
+    size_t last;
+    size_t grain;
+    size_t chunks;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+    const void* fn;
+    void (*call)(const void*, size_t, size_t);
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::exception_ptr error;
+
+    // claim and run chunks until none is left
+    void Work() {
+        for (;;) {
+            size_t c = next.fetch_add(1, std::memory_order_relaxed);
+            if (c >= chunks) return;
+            size_t b = first + c * grain;
+            size_t e = std::min(last, b + grain);
+            try {
+                call(fn, b, e);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) error = std::current_exception();
+            }
+            if (done.fetch_add(1, std::memory_order_acq_rel) + 1 == chunks) {
+                std::lock_guard<std::mutex> lock(mutex);
+                cv.notify_all();
+            }
+        }
+    }
+};
+
+} // namespace detail
+
+/*
+ * Call `f(begin, end)` over [first, last) split into chunks of `grain`.
+ * Chunks are claimed dynamically by the caller and the pool workers, so
+ * it is safe to nest parallel loops. The first exception is rethrown.
+ */
+template <typename Fn>
+void ParallelFor(size_t first, size_t last, size_t grain, Fn&& f,
+                 ThreadPool& pool = ThreadPool::Get()) {
+    if (first >= last) return;
+    grain = std::max<size_t>(grain, 1);
+    size_t chunks = (last - first + grain - 1) / grain;
+    if (chunks == 1 || pool.NumWorkers() == 0) {
+        f(first, last);
+        return;
+    }
+
+    using fn_t = std::remove_reference_t<Fn>;
+    auto state = std::make_shared<detail::LoopState>();
+    state->first = first;
+    state->last = last;
+    state->grain = grain;
+    state->chunks = chunks;
+    state->fn = &f;
+    state->call = [](const void* fn, size_t b, size_t e) {
+        (*static_cast<fn_t*>(const_cast<void*>(fn)))(b, e);
+    };
+
+    size_t helpers = std::min(pool.NumWorkers(), chunks - 1);
+    for (size_t i = 0; i < helpers; ++i) {
+        pool.Submit([state] { state->Work(); });
+    }
+    state->Work();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [&] {
+        return state->done.load(std::memory_order_acquire) == chunks;
+    });
+    if (state->error) std::rethrow_exception(state->error);
+}
+
+/*
+ * k-th of `parts` contiguous, nearly equal ranges of [first, last)
+ */
+inline std::pair<size_t, size_t> StaticPartition(size_t first, size_t last,
+                                                 size_t k, size_t parts) {
+    size_t n = last - first;
+    size_t q = n / parts, r = n % parts;
+    size_t b = first + k * q + std::min(k, r);
+    return {b, b + q + (k < r ? 1 : 0)};
+}
+
+/*
+ * Call `f(begin, end)` on StaticPartition(first, last, k, NumWorkers())
+ * from worker k, so that data touched by part k is always touched by the
+ * same worker. Runs inline when called from a worker of the pool.
+ */
+template <typename Fn>
+void ParallelForStatic(size_t first, size_t last, Fn&& f,
+                       ThreadPool& pool = ThreadPool::Get()) {
+    if (first >= last) return;
+    size_t parts = pool.NumWorkers();
+    if (parts <= 1 || ThreadPool::WorkerIndex() >= 0) {
+        f(first, last);
+        return;
+    }
+
+    std::mutex m;
+    std::condition_variable cv;
+    size_t done = 0;
+    std::exception_ptr error;
+    for (size_t k = 0; k < parts; ++k) {
+        pool.SubmitTo(k, [&, k] {
+            auto range = StaticPartition(first, last, k, parts);
+            try {
+                if (range.first < range.second) f(range.first, range.second);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(m);
+                if (!error) error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(m);
+            if (++done == parts) cv.notify_one();
+        });
+    }
+    std::unique_lock<std::mutex> lock(m);
+    cv.wait(lock, [&] { return done == parts; });
+    if (error) std::rethrow_exception(error);
+}
+
+}; // namespace parallel
+
+}; // namespace mou
+
+#endif // MOU_PARALLEL_H
@@ -1,6 +1,20 @@
 #ifndef MOU_PATTERN_MATCHING_H
 #define MOU_PATTERN_MATCHING_H
 
+#include "parallel.h"
+#include "reflection.h"
+#include <array>
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
 namespace mou {
 
 namespace pm {
@@ -13,6 +27,604 @@ struct overloaded : Ts... {
 template <typename... Ts>
 overloaded(Ts...) -> overloaded<Ts...>;
 
+/*
+ * Dispatch modes of visit_all
+ * - sequential: range order, one jump-table call per element
+ * - bucketed: elements are grouped by index() first, then the handler of
+ *   each alternative runs over its group in a tight loop
+ * - parallel: bucketed dispatch over chunks of the range on the thread
+ *   pool, the visitor must be safe to call concurrently
+ */
+enum class dispatch { sequential, bucketed, parallel };
+
+constexpr size_t kVisitGrain = 4096;
+
+template <typename Visitor, typename Variant>
+struct _jump_table {
+    using variant_t = std::remove_cv_t<Variant>;
+    static constexpr size_t size = std::variant_size_v<variant_t>;
+    using fn_t = void (*)(Visitor&, Variant&);
+
+    template <size_t I>
+    static void _call(Visitor& vis, Variant& v) {
+        vis(*std::get_if<I>(&v));
+    }
+
+    template <size_t... I>
+    static constexpr std::array<fn_t, size> _make(std::index_sequence<I...>) {
+        return {{&_call<I>...}};
+    }
+
+    static constexpr std::array<fn_t, size> table =
+        _make(std::make_index_sequence<size>{});
+};
+
+template <typename Visitor, typename Variant>
+inline void _visit_one(Visitor& vis, Variant& v) {
+    if (v.valueless_by_exception()) throw std::bad_variant_access();
+    _jump_table<Visitor, Variant>::table[v.index()](vis, v);
+}
+
+template <typename Visitor, typename Variant, size_t I>
+inline void _visit_bucket(Visitor& vis, Variant* const* first,
+                          Variant* const* last) {
+    for (; first != last; ++first) {
+        vis(*std::get_if<I>(*first));
+    }
+}
+
+template <typename Visitor, typename Variant, size_t... I>
+void _visit_buckets(Visitor& vis, Variant* const* buf, const size_t* offset,
+                    std::index_sequence<I...>) {
+    (_visit_bucket<Visitor, Variant, I>(vis, buf + offset[I],
+                                        buf + offset[I + 1]), ...);
+}
+
+/*
+ * Counting sort of [first, first + n) by index(), then one homogeneous
+ * loop per alternative
+ */
+template <typename Visitor, typename It>
+void _visit_bucketed(Visitor& vis, It first, size_t n) {
+    using Variant = std::remove_reference_t<decltype(*first)>;
+    constexpr size_t size = std::variant_size_v<std::remove_cv_t<Variant>>;
+
+    std::array<size_t, size + 1> offset{};
+    for (size_t i = 0; i < n; ++i) {
+        if (first[i].valueless_by_exception()) throw std::bad_variant_access();
+        ++offset[first[i].index() + 1];
+    }
+    for (size_t k = 0; k < size; ++k) offset[k + 1] += offset[k];
+
+    // scratch is reused across calls on the same thread, one buffer per
+    // nesting level: a visitor visiting another range of the same type
+    // gets its own buffer and never reallocates the one being walked,
+    // and deque growth keeps the buffers of the outer levels in place
+    thread_local std::deque<std::vector<Variant*> > scratch;
+    thread_local size_t depth = 0;
+    if (scratch.size() == depth) scratch.emplace_back();
+    scratch[depth].resize(n);
+    Variant** buf = scratch[depth].data();
+    struct _level {
+        size_t& depth;
+        explicit _level(size_t& d) : depth(d) { ++depth; }
+        ~_level() { --depth; }
+    } level(depth);
+    std::array<size_t, size + 1> pos = offset;
+    for (size_t i = 0; i < n; ++i) {
+        buf[pos[first[i].index()]++] = &first[i];
+    }
+
+    _visit_buckets<Visitor, Variant>(vis, buf, offset.data(),
+                                     std::make_index_sequence<size>{});
+}
+
+/*
+ * Visit every variant of a random access range
+ *
+ * Example:
+ *  std::vector<std::variant<int, double>> vec = ...;
+ *  visit_all(overloaded {
+ *      [](int arg) { ... },
+ *      [](double arg) { ... },
+ *  }, vec, dispatch::bucketed);
+ */
+template <typename Visitor, typename Range>
+void visit_all(Visitor&& vis, Range&& range,
+               dispatch mode = dispatch::sequential) {
+    auto first = std::begin(range);
+    size_t n = std::end(range) - first;
+
+    switch (mode) {
+        case dispatch::sequential:
+            for (size_t i = 0; i < n; ++i) _visit_one(vis, first[i]);
+            break;
+        case dispatch::bucketed:
+            _visit_bucketed(vis, first, n);
+            break;
+        case dispatch::parallel:
+            parallel::ParallelFor(0, n, kVisitGrain,
+                                  [&vis, first](size_t b, size_t e) {
+                _visit_bucketed(vis, first + b, e - b);
+            });
+            break;
+    }
+}
+
+/*
+ * visit_all with the handlers combined by overloaded
+ *
+ * Example:
+ *  match(vec, dispatch::bucketed,
+ *      [](int arg) { ... },
+ *      [](auto arg) { ... });
+ */
+template <typename Range, typename... Fs>
+void match(Range&& range, dispatch mode, Fs&&... fs) {
+    visit_all(overloaded{std::forward<Fs>(fs)...},
+              std::forward<Range>(range), mode);
+}
+
+/*
+ * Structural patterns
+ * - _: matches anything
+ * - lit<V>: equal to the compile-time constant V
+ * - val(x): equal to x
+ * - when(pred): pred(value) is true
+ * - ds(p...): an aggregate, or tuple-like value, whose fields match p...
+ *
+ * Example:
+ *  struct msg { int kind; int code; std::string body; };
+ *  auto r = match(m,
+ *      case_(ds(lit<1>, lit<200>, _), [](const msg&) { return "ok"; }),
+ *      case_(ds(lit<1>, _, _), [](auto& m) { return m.code > 0; },
+ *            [](const msg&) { return "positive"; }),
+ *      case_(ds(lit<2>, val(code), _), [](int, int, auto&) { return "two"; }),
+ *      case_(_, [] { return "other"; }));
+ *
+ * Handlers and guards are called with the value, with no arguments, or
+ * with the fields of the value, whichever they accept.
+ *
+ * Cases are not tried one after another. The value itself, if some case
+ * compares it against a lit<V>, or else the first field that some ds()
+ * compares against a lit<V>, becomes the discriminant. At compile time the cases are grouped by their
+ * constant at that field; at run time the group is found with a jump
+ * table when the constants are dense, or a binary search otherwise, and
+ * only the cases of that group, plus those not fixing the field, are
+ * tried in their original order. First-match semantics are preserved.
+ */
+struct wildcard_t {
+    template <typename T>
+    constexpr bool Match(const T&) const {
+        return true;
+    }
+};
+
+inline constexpr wildcard_t _{};
+
+template <auto V>
+struct lit_t {
+    template <typename T>
+    constexpr bool Match(const T& v) const {
+        return v == V;
+    }
+};
+
+template <auto V>
+inline constexpr lit_t<V> lit{};
+
+template <typename T>
+struct val_t {
+    T x;
+
+    template <typename U>
+    constexpr bool Match(const U& v) const {
+        return v == x;
+    }
+};
+
+template <typename T>
+constexpr val_t<std::decay_t<T> > val(T&& x) {
+    return {std::forward<T>(x)};
+}
+
+template <typename Pred>
+struct when_t {
+    Pred pred;
+
+    template <typename T>
+    constexpr bool Match(const T& v) const {
+        return static_cast<bool>(pred(v));
+    }
+};
+
+template <typename Pred>
+constexpr when_t<std::decay_t<Pred> > when(Pred&& pred) {
+    return {std::forward<Pred>(pred)};
+}
+
+template <typename T, typename = void>
+struct _is_tuple_like : std::false_type {};
+
+template <typename T>
+struct _is_tuple_like<T, std::void_t<decltype(std::tuple_size<T>::value)> >
+    : std::true_type {};
+
+// references to the fields of an aggregate or a tuple-like value
+template <typename T>
+constexpr auto _fields_of(T& v) {
+    if constexpr (_is_tuple_like<std::remove_cv_t<T> >::value) {
+        return std::apply([](auto&... f) { return std::tie(f...); }, v);
+    } else {
+        return reflection::tie_binding(v);
+    }
+}
+
+template <typename... Ps>
+struct ds_t {
+    std::tuple<Ps...> ps;
+
+    template <typename T>
+    constexpr bool Match(const T& v) const {
+        auto fields = _fields_of(v);
+        static_assert(std::tuple_size_v<decltype(fields)> == sizeof...(Ps),
+                      "ds() needs one pattern per field");
+        return _match(fields, std::index_sequence_for<Ps...>{});
+    }
+
+ private:
+    template <typename F, size_t... I>
+    constexpr bool _match(const F& fields, std::index_sequence<I...>) const {
+        return (... && std::get<I>(ps).Match(std::get<I>(fields)));
+    }
+};
+
+template <typename... Ps>
+constexpr ds_t<std::decay_t<Ps>...> ds(Ps&&... ps) {
+    return {{std::forward<Ps>(ps)...}};
+}
+
+struct no_guard {
+    template <typename T>
+    constexpr bool operator () (const T&) const {
+        return true;
+    }
+};
+
+template <typename P, typename G, typename H>
+struct case_t {
+    using pattern = P;
+    P p;
+    G guard;
+    H handler;
+};
+
+template <typename P, typename H>
+constexpr case_t<P, no_guard, std::decay_t<H> > case_(P p, H&& handler) {
+    return {p, no_guard{}, std::forward<H>(handler)};
+}
+
+template <typename P, typename G, typename H>
+constexpr case_t<P, std::decay_t<G>, std::decay_t<H> >
+case_(P p, G&& guard, H&& handler) {
+    return {p, std::forward<G>(guard), std::forward<H>(handler)};
+}
+
+template <typename T>
+struct is_case : std::false_type {};
+
+template <typename P, typename G, typename H>
+struct is_case<case_t<P, G, H> > : std::true_type {};
+
+class no_match : public std::runtime_error {
+ public:
+    no_match() : std::runtime_error("pm::match: no case matched") {}
+};
+
+// call f with the value, nothing, or the fields of the value
+template <typename F, typename T>
+constexpr decltype(auto) _apply_case(F& f, T& v) {
+    if constexpr (std::is_invocable_v<F&, T&>) {
+        return f(v);
+    } else if constexpr (std::is_invocable_v<F&>) {
+        return f();
+    } else {
+        return std::apply(f, _fields_of(v));
+    }
+}
+
+/*
+ * Compile-time decision table
+ */
+constexpr size_t kTopLevel = static_cast<size_t>(-1);
+constexpr size_t kNoDiscriminant = static_cast<size_t>(-2);
+
+template <typename P, size_t J>
+struct _key_at {
+    static constexpr bool has = false;
+    static constexpr long long value = 0;
+};
+
+template <auto V>
+struct _key_at<lit_t<V>, kTopLevel> {
+    static constexpr bool has = true;
+    static constexpr long long value = static_cast<long long>(V);
+};
+
+template <size_t J, bool InRange, typename... Ps>
+struct _ds_key_at : _key_at<void, J> {};
+
+template <size_t J, typename... Ps>
+struct _ds_key_at<J, true, Ps...>
+    : _key_at<std::tuple_element_t<J, std::tuple<Ps...> >, kTopLevel> {};
+
+template <typename... Ps, size_t J>
+struct _key_at<ds_t<Ps...>, J>
+    : _ds_key_at<J, (J < sizeof...(Ps)), Ps...> {};
+
+template <size_t J, typename... Cs>
+constexpr size_t _first_keyed_field() {
+    if constexpr (J >= reflection::kMaxFields) {
+        return kNoDiscriminant;
+    } else if constexpr ((... || _key_at<typename Cs::pattern, J>::has)) {
+        return J;
+    } else {
+        return _first_keyed_field<J + 1, Cs...>();
+    }
+}
+
+template <typename... Cs>
+constexpr size_t _discriminant_of() {
+    if constexpr ((... || _key_at<typename Cs::pattern, kTopLevel>::has)) {
+        return kTopLevel;
+    } else {
+        return _first_keyed_field<0, Cs...>();
+    }
+}
+
+template <size_t N>
+constexpr size_t _count_keys(const std::array<bool, N>& has,
+                             const std::array<long long, N>& key) {
+    size_t k = 0;
+    for (size_t i = 0; i < N; ++i) {
+        if (!has[i]) continue;
+        bool seen = false;
+        for (size_t j = 0; j < i; ++j) {
+            if (has[j] && key[j] == key[i]) seen = true;
+        }
+        if (!seen) ++k;
+    }
+    return k;
+}
+
+// distinct keys in ascending order
+template <size_t K, size_t N>
+constexpr std::array<long long, K> _sorted_keys(
+        const std::array<bool, N>& has, const std::array<long long, N>& key) {
+    std::array<long long, K> out{};
+    size_t k = 0;
+    for (size_t i = 0; i < N; ++i) {
+        if (!has[i]) continue;
+        bool seen = false;
+        for (size_t j = 0; j < k; ++j) {
+            if (out[j] == key[i]) seen = true;
+        }
+        if (seen) continue;
+        size_t p = k++;
+        while (p > 0 && out[p - 1] > key[i]) {
+            out[p] = out[p - 1];
+            --p;
+        }
+        out[p] = key[i];
+    }
+    return out;
+}
+
+/*
+ * Case i is a candidate of group g < K if its key is keys[g], and of
+ * every group if it has no key. Group K holds the cases without key.
+ */
+template <size_t K, size_t N>
+constexpr bool _in_group(const std::array<bool, N>& has,
+                         const std::array<long long, N>& key,
+                         const std::array<long long, K>& keys,
+                         size_t i, size_t g) {
+    return !has[i] || (g < K && key[i] == keys[g]);
+}
+
+template <size_t K, size_t N>
+constexpr std::array<size_t, K + 2> _group_offsets(
+        const std::array<bool, N>& has, const std::array<long long, N>& key,
+        const std::array<long long, K>& keys) {
+    std::array<size_t, K + 2> out{};
+    for (size_t g = 0; g <= K; ++g) {
+        out[g + 1] = out[g];
+        for (size_t i = 0; i < N; ++i) {
+            out[g + 1] += _in_group(has, key, keys, i, g);
+        }
+    }
+    return out;
+}
+
+template <size_t T, size_t K, size_t N>
+constexpr std::array<size_t, T> _group_candidates(
+        const std::array<bool, N>& has, const std::array<long long, N>& key,
+        const std::array<long long, K>& keys) {
+    std::array<size_t, T> out{};
+    size_t t = 0;
+    for (size_t g = 0; g <= K; ++g) {
+        for (size_t i = 0; i < N; ++i) {
+            if (_in_group(has, key, keys, i, g)) out[t++] = i;
+        }
+    }
+    return out;
+}
+
+template <size_t S, size_t K>
+constexpr std::array<size_t, S> _direct_table(
+        const std::array<long long, K>& keys) {
+    std::array<size_t, S> out{};
+    for (auto& o : out) o = K;
+    for (size_t g = 0; g < K; ++g) {
+        auto off = static_cast<unsigned long long>(keys[g])
+            - static_cast<unsigned long long>(keys[0]);
+        if (off < S) out[off] = g;
+    }
+    return out;
+}
+
+template <size_t D, typename... Cs>
+struct _decision {
+    static constexpr size_t N = sizeof...(Cs);
+    static constexpr std::array<bool, N> has =
+        {{_key_at<typename Cs::pattern, D>::has...}};
+    static constexpr std::array<long long, N> key =
+        {{_key_at<typename Cs::pattern, D>::value...}};
+
+    static constexpr size_t K = _count_keys(has, key);
+    static constexpr std::array<long long, K> keys =
+        _sorted_keys<K>(has, key);
+
+    // candidates of group g are cand[offset[g], offset[g + 1])
+    static constexpr std::array<size_t, K + 2> offset =
+        _group_offsets(has, key, keys);
+    static constexpr std::array<size_t, offset[K + 1]> cand =
+        _group_candidates<offset[K + 1]>(has, key, keys);
+
+    // a direct lookup table when the keys are dense enough
+    static constexpr unsigned long long span =
+        K == 0 ? 0 : static_cast<unsigned long long>(keys[K - 1])
+                     - static_cast<unsigned long long>(keys[0]) + 1;
+    static constexpr bool dense = K > 0 && span <= 2 * K + 8;
+    static constexpr std::array<size_t, dense ? span : 1> direct =
+        _direct_table<dense ? span : 1>(keys);
+
+    static size_t Group(long long x) {
+        if constexpr (K == 0) {
+            (void)x;
+            return K;
+        } else if constexpr (dense) {
+            auto off = static_cast<unsigned long long>(x)
+                - static_cast<unsigned long long>(keys[0]);
+            return off < span ? direct[off] : K;
+        } else {
+            size_t lo = 0, hi = K;
+            while (lo < hi) {
+                size_t mid = (lo + hi) / 2;
+                if (keys[mid] < x) lo = mid + 1;
+                else hi = mid;
+            }
+            return lo < K && keys[lo] == x ? lo : K;
+        }
+    }
+};
+
+template <size_t D, typename T>
+constexpr long long _discriminant(T& v) {
+    if constexpr (D == kTopLevel) {
+        return static_cast<long long>(v);
+    } else {
+        return static_cast<long long>(std::get<D>(_fields_of(v)));
+    }
+}
+
+template <size_t D, typename T>
+struct _discriminant_type {
+    using type = std::decay_t<decltype(std::get<D>(
+        _fields_of(std::declval<T&>())))>;
+};
+
+template <typename T>
+struct _discriminant_type<kTopLevel, T> {
+    using type = std::decay_t<T>;
+};
+
+/*
+ * The decision table switches on integral and enum discriminants only,
+ * converting anything else to long long, e.g. a NaN double, is undefined
+ */
+template <size_t D, typename T>
+constexpr bool _switchable() {
+    if constexpr (D == kNoDiscriminant) {
+        return false;
+    } else {
+        using K = typename _discriminant_type<D, T>::type;
+        return std::is_integral_v<K> || std::is_enum_v<K>;
+    }
+}
+
+template <typename T, typename... Cs>
+using _match_result_t = std::common_type_t<
+    decltype(_apply_case(std::declval<decltype(Cs::handler)&>(),
+                         std::declval<T&>()))...>;
+
+template <typename R>
+struct _result_slot {
+    std::optional<R> value;
+};
+
+template <>
+struct _result_slot<void> {
+    bool value = false;
+};
+
+template <size_t I, typename R, typename T, typename Cases>
+bool _try_case(Cases& cases, T& v, _result_slot<R>& out) {
+    auto& c = std::get<I>(cases);
+    if (!c.p.Match(v) || !_apply_case(c.guard, v)) return false;
+    if constexpr (std::is_void_v<R>) {
+        _apply_case(c.handler, v);
+        out.value = true;
+    } else {
+        out.value.emplace(_apply_case(c.handler, v));
+    }
+    return true;
+}
+
+template <typename R, typename T, typename Cases, size_t... I>
+constexpr auto _case_table(std::index_sequence<I...>) {
+    using fn_t = bool (*)(Cases&, T&, _result_slot<R>&);
+    return std::array<fn_t, sizeof...(I)>{{&_try_case<I, R, T, Cases>...}};
+}
+
+/*
+ * Match a value against cases, returns what the handler of the first
+ * matching case returns. Throws no_match when no case matches, unless
+ * the handlers return void.
+ */
+template <typename T, typename... Cs,
+          typename = std::enable_if_t<(sizeof...(Cs) > 0) &&
+                                      (... && is_case<Cs>::value)> >
+decltype(auto) match(T&& subject, Cs... cases) {
+    using S = std::remove_reference_t<T>;
+    using R = _match_result_t<S, Cs...>;
+    using cases_t = std::tuple<Cs...>;
+    // other discriminants fall back to testing every case in order
+    constexpr size_t D = _switchable<_discriminant_of<Cs...>(), S>()
+        ? _discriminant_of<Cs...>() : kNoDiscriminant;
+    using table_t = _decision<D, Cs...>;
+    static constexpr auto try_case = _case_table<R, S, cases_t>(
+            std::index_sequence_for<Cs...>{});
+
+    S& v = subject;
+    cases_t cs{std::move(cases)...};
+    _result_slot<R> out;
+    size_t g = table_t::K;
+    if constexpr (D != kNoDiscriminant) {
+        g = table_t::Group(_discriminant<D>(v));
+    }
+    for (size_t p = table_t::offset[g]; p < table_t::offset[g + 1]; ++p) {
+        if (try_case[table_t::cand[p]](cs, v, out)) break;
+    }
+
+    if constexpr (std::is_void_v<R>) {
+        return;
+    } else {
+        if (!out.value) throw no_match();
+        return R(std::move(*out.value));
+    }
+}
+
 }; // namespace pm
 
 }; // namespace mou
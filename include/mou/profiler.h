@@ -0,0 +1,384 @@
+#ifndef MOU_PROFILER_H
+#define MOU_PROFILER_H
+
+/*
+ * \brief: opt-in instrumentation for hot paths
+ *
+ * Define MOU_ENABLE_PROFILER before including any mou header to turn the
+ * MOU_PROFILE_* macros on. When it is not defined they expand to nothing,
+ * so instrumented code pays no cost at all.
+ *
+ * Example:
+ *  #define MOU_ENABLE_PROFILER
+ *  #include "mou/tensor.h"
+ *  ...
+ *  {
+ *      MOU_PROFILE_REGION("forward");
+ *      y = F<axpy>(w, x, b);
+ *  }
+ *  profiler::WriteJson(std::cout, profiler::Collect());
+ */
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace mou {
+
+namespace profiler {
+
+enum class op { allocate, deallocate, copy, slice, eval, num_ops };
+
+constexpr size_t kNumOps = static_cast<size_t>(op::num_ops);
+
+inline const char* Name(op o) {
+    switch (o) {
+        case op::allocate   : return "allocate";
+        case op::deallocate : return "deallocate";
+        case op::copy       : return "copy";
+        case op::slice      : return "slice";
+        case op::eval       : return "eval";
+        default             : return "unknown";
+    }
+}
+
+inline std::ostream& operator << (std::ostream& os, op o) {
+    return os << Name(o);
+}
+
+/*
+ * Aggregated numbers of a single operation or region
+ * - calls: number of times it was entered
+ * - nanoseconds: wall time spent inside
+ * - bytes: bytes allocated, freed or moved
+ * - elements: elements evaluated
+ */
+struct Stats {
+    uint64_t calls = 0;
+    uint64_t nanoseconds = 0;
+    uint64_t bytes = 0;
+    uint64_t elements = 0;
+
+    Stats& operator += (const Stats& other) {
+        calls += other.calls;
+        nanoseconds += other.nanoseconds;
+        bytes += other.bytes;
+        elements += other.elements;
+        return *this;
+    }
+};
+
+struct Snapshot {
+    std::array<Stats, kNumOps> ops;
+    std::map<std::string, Stats> regions;
+
+    const Stats& operator [] (op o) const {
+        return ops[static_cast<size_t>(o)];
+    }
+};
+
+namespace detail {
+
+// Written by its owning thread only, read by whoever collects a report.
+// Relaxed load/store pairs keep the hot path free of locked instructions.
+// A reset never writes the counters, which would race with the owner, but
+// records their values in `base`, subtracted when the slot is read.
+struct Slot {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> nanoseconds{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> elements{0};
+    // guarded by the mutex of the Registry
+    Stats base;
+
+    static void _add(std::atomic<uint64_t>& c, uint64_t v) {
+        c.store(c.load(std::memory_order_relaxed) + v,
+                std::memory_order_relaxed);
+    }
+
+    void Add(uint64_t ns, uint64_t b, uint64_t e) {
+        _add(calls, 1);
+        _add(nanoseconds, ns);
+        _add(bytes, b);
+        _add(elements, e);
+    }
+
+    Stats Total() const {
+        Stats s;
+        s.calls = calls.load(std::memory_order_relaxed);
+        s.nanoseconds = nanoseconds.load(std::memory_order_relaxed);
+        s.bytes = bytes.load(std::memory_order_relaxed);
+        s.elements = elements.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    // counts since the last Clear()
+    Stats Load() const {
+        Stats s = Total();
+        s.calls -= base.calls;
+        s.nanoseconds -= base.nanoseconds;
+        s.bytes -= base.bytes;
+        s.elements -= base.elements;
+        return s;
+    }
+
+    void Clear() {
+        base = Total();
+    }
+};
+
+struct ThreadCounters {
+    std::array<Slot, kNumOps> ops;
+    // regions are keyed by the address of a string literal, the lock is
+    // only contended while a report is being collected
+    std::mutex region_mutex;
+    std::map<const char*, Slot> regions;
+
+    Slot& Region(const char* name) {
+        std::lock_guard<std::mutex> lock(region_mutex);
+        return regions[name];
+    }
+
+    void MergeInto(Snapshot& snap) {
+        for (size_t i = 0; i < kNumOps; ++i) {
+            snap.ops[i] += ops[i].Load();
+        }
+        std::lock_guard<std::mutex> lock(region_mutex);
+        for (auto& kv : regions) {
+            snap.regions[kv.first] += kv.second.Load();
+        }
+    }
+
+    void Clear() {
+        for (auto& s : ops) s.Clear();
+        std::lock_guard<std::mutex> lock(region_mutex);
+        for (auto& kv : regions) kv.second.Clear();
+    }
+};
+
+class Registry {
+ public:
+    static Registry& Get() {
+        static Registry inst;
+        return inst;
+    }
+
+    void Register(ThreadCounters* c) {
+        std::lock_guard<std::mutex> lock(mutex);
+        live.push_back(c);
+    }
+
+    // counters of an exiting thread are folded into `retired`
+    void Unregister(ThreadCounters* c) {
+        std::lock_guard<std::mutex> lock(mutex);
+        c->MergeInto(retired);
+        for (size_t i = 0; i < live.size(); ++i) {
+            if (live[i] == c) {
+                live[i] = live.back();
+                live.pop_back();
+                break;
+            }
+        }
+    }
+
+    Snapshot Collect() {
+        std::lock_guard<std::mutex> lock(mutex);
+        Snapshot snap = retired;
+        for (auto* c : live) {
+            c->MergeInto(snap);
+        }
+        return snap;
+    }
+
+    void Reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        retired = Snapshot();
+        for (auto* c : live) {
+            c->Clear();
+        }
+    }
+
+ private:
+    std::mutex mutex;
+    std::vector<ThreadCounters*> live;
+    Snapshot retired;
+};
+
+struct LocalHandle {
+    ThreadCounters counters;
+
+    LocalHandle() {
+        Registry::Get().Register(&counters);
+    }
+
+    ~LocalHandle() {
+        Registry::Get().Unregister(&counters);
+    }
+};
+
+inline ThreadCounters& Local() {
+    // make sure the registry outlives every thread-local handle
+    static Registry& registry = Registry::Get();
+    (void)registry;
+    thread_local LocalHandle handle;
+    return handle.counters;
+}
+
+inline uint64_t Now() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(
+        steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace detail
+
+/*
+ * Add bytes and elements to an operation without timing it
+ */
+inline void Count(op o, uint64_t bytes, uint64_t elements = 0) {
+    detail::Local().ops[static_cast<size_t>(o)].Add(0, bytes, elements);
+}
+
+/*
+ * RAII timer, charges the elapsed time of its scope to an operation or to
+ * a named region. Region names must outlive the program, e.g. literals.
+ */
+class ScopedTimer {
+ public:
+    explicit ScopedTimer(op o, uint64_t bytes = 0, uint64_t elements = 0)
+        : slot(&detail::Local().ops[static_cast<size_t>(o)]),
+          bytes(bytes), elements(elements), start(detail::Now()) {}
+
+    explicit ScopedTimer(const char* region)
+        : slot(&detail::Local().Region(region)),
+          bytes(0), elements(0), start(detail::Now()) {}
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator = (const ScopedTimer&) = delete;
+
+    ~ScopedTimer() {
+        slot->Add(detail::Now() - start, bytes, elements);
+    }
+
+ private:
+    detail::Slot* slot;
+    uint64_t bytes;
+    uint64_t elements;
+    uint64_t start;
+};
+
+/*
+ * Merge the counters of all threads, alive or exited
+ */
+inline Snapshot Collect() {
+    return detail::Registry::Get().Collect();
+}
+
+/*
+ * Start counting from zero, safe while other threads are counting
+ */
+inline void Reset() {
+    detail::Registry::Get().Reset();
+}
+
+namespace detail {
+
+inline void _write_json_string(std::ostream& os, const std::string& s) {
+    os << '"';
+    for (char c : s) {
+        switch (c) {
+            case '"'  : os << "\\\""; break;
+            case '\\' : os << "\\\\"; break;
+            case '\n' : os << "\\n"; break;
+            case '\t' : os << "\\t"; break;
+            default   : os << c;
+        }
+    }
+    os << '"';
+}
+
+inline void _write_json_stats(std::ostream& os, const Stats& s) {
+    os << "{\"calls\":" << s.calls
+       << ",\"nanoseconds\":" << s.nanoseconds
+       << ",\"bytes\":" << s.bytes
+       << ",\"elements\":" << s.elements << '}';
+}
+
+inline void _write_text_stats(std::ostream& os, const std::string& name,
+                              const Stats& s) {
+    os << name << ": calls=" << s.calls
+       << " time=" << s.nanoseconds / 1e6 << "ms"
+       << " bytes=" << s.bytes
+       << " elements=" << s.elements << '\n';
+}
+
+} // namespace detail
+
+/*
+ * Example:
+ *  {"ops":{"allocate":{"calls":2,"nanoseconds":310,"bytes":64,"elements":0},
+ *  ...},"regions":{"forward":{...}}}
+ */
+inline void WriteJson(std::ostream& os, const Snapshot& snap) {
+    os << "{\"ops\":{";
+    for (size_t i = 0; i < kNumOps; ++i) {
+        if (i != 0) os << ',';
+        os << '"' << Name(static_cast<op>(i)) << "\":";
+        detail::_write_json_stats(os, snap.ops[i]);
+    }
+    os << "},\"regions\":{";
+    bool first = true;
+    for (auto& kv : snap.regions) {
+        if (!first) os << ',';
+        first = false;
+        detail::_write_json_string(os, kv.first);
+        os << ':';
+        detail::_write_json_stats(os, kv.second);
+    }
+    os << "}}";
+}
+
+inline void WriteText(std::ostream& os, const Snapshot& snap) {
+    for (size_t i = 0; i < kNumOps; ++i) {
+        detail::_write_text_stats(os, Name(static_cast<op>(i)), snap.ops[i]);
+    }
+    for (auto& kv : snap.regions) {
+        detail::_write_text_stats(os, kv.first, kv.second);
+    }
+}
+
+}; // namespace profiler
+
+}; // namespace mou
+
+#define MOU_PROFILE_CONCAT_(a, b) a##b
+#define MOU_PROFILE_CONCAT(a, b) MOU_PROFILE_CONCAT_(a, b)
+
+#ifdef MOU_ENABLE_PROFILER
+
+#define MOU_PROFILE_SCOPE(OP, BYTES, ELEMENTS)                              \
+    ::mou::profiler::ScopedTimer MOU_PROFILE_CONCAT(_mou_timer_, __LINE__)  \
+        ((OP), (BYTES), (ELEMENTS))
+
+#define MOU_PROFILE_REGION(NAME)                                            \
+    ::mou::profiler::ScopedTimer MOU_PROFILE_CONCAT(_mou_timer_, __LINE__)  \
+        (NAME)
+
+#define MOU_PROFILE_COUNT(OP, BYTES, ELEMENTS)                              \
+    ::mou::profiler::Count((OP), (BYTES), (ELEMENTS))
+
+#else
+
+#define MOU_PROFILE_SCOPE(OP, BYTES, ELEMENTS) ((void)0)
+#define MOU_PROFILE_REGION(NAME) ((void)0)
+#define MOU_PROFILE_COUNT(OP, BYTES, ELEMENTS) ((void)0)
+
+#endif // MOU_ENABLE_PROFILER
+
+#endif // MOU_PROFILER_H
@@ -1,8 +1,10 @@
 #ifndef MOU_REFLECTION_H
 #define MOU_REFLECTION_H
 
+#include <cstddef>
 #include <tuple>
 #include <type_traits>
+#include <utility>
 
 namespace mou {
 
@@ -16,6 +18,11 @@ namespace reflection {
  *  static_assert(std::is_same_v<decltype(ts), std::tuple<int, char>>);
  *  assert(std::get<0>(ts) == 1);
  *  assert(std::get<1>(ts) == 'a');
+ *
+ *  // references instead of copies
+ *  std::get<0>(tie_binding(s)) = 2;
+ *  assert(s.a == 2);
+ *  static_assert(field_count_v<sc> == 2);
  */
 
 struct any_type {
@@ -34,23 +41,551 @@ _is_constructible(...);
 template <typename T, typename... Any>
 using is_constructible = decltype(_is_constructible<T, Any...>(0));
 
+/*
+ * Number of fields of an aggregate, detected by the largest brace
+ * initializer it accepts. Array members and base classes are not supported.
+ */
+constexpr size_t kMaxFields = 64;
+
+template <size_t>
+using _any_field = any_type;
+
+template <typename T, size_t... I>
+constexpr bool _is_constructible_n(std::index_sequence<I...>) {
+    return is_constructible<T, _any_field<I>...>::value;
+}
+
+template <typename T, size_t N = 0>
+constexpr size_t _count_fields() {
+    if constexpr (N < kMaxFields &&
+                  _is_constructible_n<T>(std::make_index_sequence<N + 1>{})) {
+        return _count_fields<T, N + 1>();
+    } else {
+        return N;
+    }
+}
+
 template <typename T>
-auto tuple_binding(T&& t) noexcept {
-    using type = std::decay_t<T>;
-    if constexpr (is_constructible<type, any_type, any_type, any_type>::value) {
-        auto&& [a, b, c] = std::forward<T&&>(t);
-        return std::make_tuple(a, b, c);
-    } else if constexpr (is_constructible<type, any_type, any_type>::value) {
-        auto&& [a, b] = std::forward<T&&>(t);
-        return std::make_tuple(a, b);
-    } else if constexpr (is_constructible<type, any_type>::value) {
-        auto&& [a] = std::forward<T&&>(t);
-        return std::make_tuple(a);
+constexpr size_t _field_count() {
+    using type = std::remove_cv_t<T>;
+    if constexpr (std::is_aggregate_v<type>) {
+        static_assert(!_is_constructible_n<type>(
+                          std::make_index_sequence<kMaxFields + 1>{}),
+                      "too many fields to reflect");
+        return _count_fields<type>();
     } else {
-        return std::make_tuple();
+        return 0;
     }
 }
 
+template <typename T>
+constexpr size_t field_count_v = _field_count<T>();
+
+template <size_t N, typename T>
+constexpr auto _tie_fields(T& t) noexcept {
+    if constexpr (N == 0) {
+        (void)t;
+        return std::tie();
+    } else if constexpr (N == 1) {
+        auto& [f0] = t;
+        return std::tie(f0);
+    } else if constexpr (N == 2) {
+        auto& [f0, f1] = t;
+        return std::tie(f0, f1);
+    } else if constexpr (N == 3) {
+        auto& [f0, f1, f2] = t;
+        return std::tie(f0, f1, f2);
+    } else if constexpr (N == 4) {
+        auto& [f0, f1, f2, f3] = t;
+        return std::tie(f0, f1, f2, f3);
+    } else if constexpr (N == 5) {
+        auto& [f0, f1, f2, f3, f4] = t;
+        return std::tie(f0, f1, f2, f3, f4);
+    } else if constexpr (N == 6) {
+        auto& [f0, f1, f2, f3, f4, f5] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5);
+    } else if constexpr (N == 7) {
+        auto& [f0, f1, f2, f3, f4, f5, f6] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6);
+    } else if constexpr (N == 8) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7);
+    } else if constexpr (N == 9) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8);
+    } else if constexpr (N == 10) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9);
+    } else if constexpr (N == 11) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10);
+    } else if constexpr (N == 12) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11);
+    } else if constexpr (N == 13) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12);
+    } else if constexpr (N == 14) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13);
+    } else if constexpr (N == 15) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13,
+              f14] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14);
+    } else if constexpr (N == 16) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15);
+    } else if constexpr (N == 17) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16);
+    } else if constexpr (N == 18) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17);
+    } else if constexpr (N == 19) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18);
+    } else if constexpr (N == 20) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19);
+    } else if constexpr (N == 21) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20);
+    } else if constexpr (N == 22) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21);
+    } else if constexpr (N == 23) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22);
+    } else if constexpr (N == 24) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23);
+    } else if constexpr (N == 25) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24);
+    } else if constexpr (N == 26) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25);
+    } else if constexpr (N == 27) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26);
+    } else if constexpr (N == 28) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26,
+              f27] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27);
+    } else if constexpr (N == 29) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28);
+    } else if constexpr (N == 30) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29);
+    } else if constexpr (N == 31) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30);
+    } else if constexpr (N == 32) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31);
+    } else if constexpr (N == 33) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32);
+    } else if constexpr (N == 34) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33);
+    } else if constexpr (N == 35) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34);
+    } else if constexpr (N == 36) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35);
+    } else if constexpr (N == 37) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36);
+    } else if constexpr (N == 38) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37);
+    } else if constexpr (N == 39) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38);
+    } else if constexpr (N == 40) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39);
+    } else if constexpr (N == 41) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39,
+              f40] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40);
+    } else if constexpr (N == 42) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41);
+    } else if constexpr (N == 43) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42);
+    } else if constexpr (N == 44) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43);
+    } else if constexpr (N == 45) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44);
+    } else if constexpr (N == 46) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44, f45] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44, f45);
+    } else if constexpr (N == 47) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44, f45, f46] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44, f45, f46);
+    } else if constexpr (N == 48) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44, f45, f46, f47] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44, f45, f46, f47);
+    } else if constexpr (N == 49) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44, f45, f46, f47, f48] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44, f45, f46, f47, f48);
+    } else if constexpr (N == 50) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44, f45, f46, f47, f48, f49] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44, f45, f46, f47, f48,
+                f49);
+    } else if constexpr (N == 51) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44, f45, f46, f47, f48, f49, f50] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44, f45, f46, f47, f48,
+                f49, f50);
+    } else if constexpr (N == 52) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44, f45, f46, f47, f48, f49, f50, f51] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44, f45, f46, f47, f48,
+                f49, f50, f51);
+    } else if constexpr (N == 53) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44, f45, f46, f47, f48, f49, f50, f51, f52] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44, f45, f46, f47, f48,
+                f49, f50, f51, f52);
+    } else if constexpr (N == 54) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44, f45, f46, f47, f48, f49, f50, f51, f52,
+              f53] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44, f45, f46, f47, f48,
+                f49, f50, f51, f52, f53);
+    } else if constexpr (N == 55) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44, f45, f46, f47, f48, f49, f50, f51, f52, f53,
+              f54] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44, f45, f46, f47, f48,
+                f49, f50, f51, f52, f53, f54);
+    } else if constexpr (N == 56) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44, f45, f46, f47, f48, f49, f50, f51, f52, f53,
+              f54, f55] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44, f45, f46, f47, f48,
+                f49, f50, f51, f52, f53, f54, f55);
+    } else if constexpr (N == 57) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44, f45, f46, f47, f48, f49, f50, f51, f52, f53,
+              f54, f55, f56] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44, f45, f46, f47, f48,
+                f49, f50, f51, f52, f53, f54, f55, f56);
+    } else if constexpr (N == 58) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44, f45, f46, f47, f48, f49, f50, f51, f52, f53,
+              f54, f55, f56, f57] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44, f45, f46, f47, f48,
+                f49, f50, f51, f52, f53, f54, f55, f56, f57);
+    } else if constexpr (N == 59) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44, f45, f46, f47, f48, f49, f50, f51, f52, f53,
+              f54, f55, f56, f57, f58] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44, f45, f46, f47, f48,
+                f49, f50, f51, f52, f53, f54, f55, f56, f57, f58);
+    } else if constexpr (N == 60) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44, f45, f46, f47, f48, f49, f50, f51, f52, f53,
+              f54, f55, f56, f57, f58, f59] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44, f45, f46, f47, f48,
+                f49, f50, f51, f52, f53, f54, f55, f56, f57, f58, f59);
+    } else if constexpr (N == 61) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44, f45, f46, f47, f48, f49, f50, f51, f52, f53,
+              f54, f55, f56, f57, f58, f59, f60] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44, f45, f46, f47, f48,
+                f49, f50, f51, f52, f53, f54, f55, f56, f57, f58, f59, f60);
+    } else if constexpr (N == 62) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44, f45, f46, f47, f48, f49, f50, f51, f52, f53,
+              f54, f55, f56, f57, f58, f59, f60, f61] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44, f45, f46, f47, f48,
+                f49, f50, f51, f52, f53, f54, f55, f56, f57, f58, f59, f60,
+                f61);
+    } else if constexpr (N == 63) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44, f45, f46, f47, f48, f49, f50, f51, f52, f53,
+              f54, f55, f56, f57, f58, f59, f60, f61, f62] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44, f45, f46, f47, f48,
+                f49, f50, f51, f52, f53, f54, f55, f56, f57, f58, f59, f60,
+                f61, f62);
+    } else if constexpr (N == 64) {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+              f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27,
+              f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40,
+              f41, f42, f43, f44, f45, f46, f47, f48, f49, f50, f51, f52, f53,
+              f54, f55, f56, f57, f58, f59, f60, f61, f62, f63] = t;
+        return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+                f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24,
+                f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36,
+                f37, f38, f39, f40, f41, f42, f43, f44, f45, f46, f47, f48,
+                f49, f50, f51, f52, f53, f54, f55, f56, f57, f58, f59, f60,
+                f61, f62, f63);
+    } else {
+        static_assert(N <= kMaxFields, "too many fields to reflect");
+    }
+}
+
+/*
+ * Tuple of references to every field, const if `t` is const
+ */
+template <typename T>
+constexpr auto tie_binding(T& t) noexcept {
+    return _tie_fields<field_count_v<T> >(t);
+}
+
+template <typename T>
+void tie_binding(const T&&) = delete;
+
+template <typename T>
+constexpr auto ctie_binding(const T& t) noexcept {
+    return _tie_fields<field_count_v<T> >(t);
+}
+
+template <typename T>
+void ctie_binding(const T&&) = delete;
+
+/*
+ * Tuple holding a copy of every field, fields of an rvalue are moved
+ */
+template <typename T>
+auto tuple_binding(T&& t) {
+    return std::apply([](auto&... f) {
+        using tuple_t = std::tuple<std::decay_t<decltype(f)>...>;
+        if constexpr (std::is_lvalue_reference_v<T>) {
+            return tuple_t(f...);
+        } else {
+            return tuple_t(std::move(f)...);
+        }
+    }, tie_binding(t));
+}
+
+template <size_t I, typename T>
+using field_t = std::tuple_element_t<I,
+      decltype(tuple_binding(std::declval<const T&>()))>;
+
+/*
+ * Call `f` on every field of `t` in declaration order
+ */
+template <typename T, typename Fn>
+constexpr void for_each_field(T& t, Fn&& f) {
+    std::apply([&f](auto&... fields) { (f(fields), ...); }, tie_binding(t));
+}
+
 }; // namespace reflection
 
 }; // namespace mou
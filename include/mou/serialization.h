@@ -0,0 +1,477 @@
+#ifndef MOU_SERIALIZATION_H
+#define MOU_SERIALIZATION_H
+
+/*
+ * \brief: binary serializer generated at compile time from reflection
+ *
+ * Supported types
+ * - arithmetic and enum types
+ * - aggregates of supported types, see reflection.h for limits
+ * - std::vector and std::string of supported types
+ * - Tensor on cpu
+ *
+ * Wire format is packed and native-endian: scalars take sizeof bytes,
+ * aggregates are their fields in declaration order, containers and tensors
+ * are prefixed by uint64 lengths. Trivially copyable aggregates without
+ * padding are copied with a single memcpy, and so are vectors of them.
+ * Within any other aggregate, neighbouring scalar fields laid out back to
+ * back are coalesced into one memcpy as well.
+ *
+ * Example:
+ *  struct point { float x, y; };
+ *  struct msg { int id; std::vector<point> path; std::string name; };
+ *  std::vector<char> buf = Encode(msg{1, {{0, 0}, {1, 1}}, "a"});
+ *  msg m = Decode<msg>(buf);
+ */
+
+#include "reflection.h"
+#include "tensor.h"
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mou {
+
+namespace serialization {
+
+class Reader {
+ public:
+    Reader(const char* first, const char* last) : cur(first), last(last) {}
+
+    const char* Take(size_t n) {
+        if (static_cast<size_t>(last - cur) < n) {
+            throw std::out_of_range("serialization: buffer too short");
+        }
+        const char* p = cur;
+        cur += n;
+        return p;
+    }
+
+    const char* Position() const {
+        return cur;
+    }
+
+    size_t Remaining() const {
+        return last - cur;
+    }
+
+ private:
+    const char* cur;
+    const char* last;
+};
+
+template <typename T, typename = void>
+struct codec;
+
+template <typename T>
+using _fields_t = decltype(reflection::tuple_binding(std::declval<const T&>()));
+
+template <typename Tuple>
+struct _all_packed;
+
+template <typename T>
+constexpr bool _is_packed();
+
+template <typename... F>
+struct _all_packed<std::tuple<F...> > {
+    static constexpr bool value = (... && _is_packed<F>());
+    static constexpr size_t size = (0 + ... + sizeof(F));
+};
+
+/*
+ * A type is packed if its memory is exactly its encoding
+ */
+template <typename T>
+constexpr bool _is_packed() {
+    if constexpr (std::is_same_v<T, bool>) {
+        // only 0 and 1 are valid bools, so they are decoded one by one
+        return false;
+    } else if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>) {
+        return true;
+    } else if constexpr (std::is_aggregate_v<T> && !std::is_array_v<T> &&
+                         std::is_trivially_copyable_v<T>) {
+        using all = _all_packed<_fields_t<T> >;
+        return all::value && all::size == sizeof(T);
+    } else {
+        return false;
+    }
+}
+
+template <typename T>
+constexpr bool is_packed_v = _is_packed<T>();
+
+template <typename T>
+struct is_tensor : std::false_type {};
+
+template <typename DType, int DevType, int DevId, typename Allocator>
+struct is_tensor<tensor::Tensor<DType, DevType, DevId, Allocator> >
+    : std::true_type {
+    static constexpr int dev_type = DevType;
+};
+
+/*
+ * Each codec provides
+ * - kFixed, kSize: whether the encoding has a constant size, and that size
+ * - Size(v): encoded size of v
+ * - Write(dst, v): write v at dst, which must hold Size(v) bytes
+ * - Read(r, v): read v from r
+ */
+template <typename T>
+struct codec<T, std::enable_if_t<is_packed_v<T> > > {
+    static constexpr bool kFixed = true;
+    static constexpr size_t kSize = sizeof(T);
+
+    static size_t Size(const T&) {
+        return kSize;
+    }
+
+    static char* Write(char* dst, const T& v) {
+        std::memcpy(dst, &v, kSize);
+        return dst + kSize;
+    }
+
+    static void Read(Reader& r, T& v) {
+        std::memcpy(&v, r.Take(kSize), kSize);
+    }
+};
+
+template <>
+struct codec<bool> {
+    static constexpr bool kFixed = true;
+    static constexpr size_t kSize = 1;
+
+    static size_t Size(bool) {
+        return kSize;
+    }
+
+    static char* Write(char* dst, bool v) {
+        *dst = v ? 1 : 0;
+        return dst + kSize;
+    }
+
+    static void Read(Reader& r, bool& v) {
+        char c = *r.Take(kSize);
+        if (c != 0 && c != 1) {
+            throw std::out_of_range("serialization: invalid bool");
+        }
+        v = c == 1;
+    }
+};
+
+inline void _write_length(char*& dst, size_t n) {
+    uint64_t len = n;
+    std::memcpy(dst, &len, sizeof(len));
+    dst += sizeof(len);
+}
+
+inline size_t _read_length(Reader& r) {
+    uint64_t len;
+    std::memcpy(&len, r.Take(sizeof(len)), sizeof(len));
+    return static_cast<size_t>(len);
+}
+
+/*
+ * Encoding of a contiguous range, a single memcpy for packed elements
+ */
+template <typename T>
+size_t _range_size(const T* p, size_t n) {
+    if constexpr (codec<T>::kFixed) {
+        (void)p;
+        return n * codec<T>::kSize;
+    } else {
+        size_t sz = 0;
+        for (size_t i = 0; i < n; ++i) sz += codec<T>::Size(p[i]);
+        return sz;
+    }
+}
+
+template <typename T>
+char* _write_range(char* dst, const T* p, size_t n) {
+    if constexpr (is_packed_v<T>) {
+        if (n != 0) std::memcpy(dst, p, n * sizeof(T));
+        return dst + n * sizeof(T);
+    } else {
+        for (size_t i = 0; i < n; ++i) dst = codec<T>::Write(dst, p[i]);
+        return dst;
+    }
+}
+
+/*
+ * Fewest bytes an element of T takes: its size if fixed, else at least a
+ * length prefix, which every variable-size encoding starts or contains
+ */
+template <typename T>
+constexpr size_t _min_size() {
+    return codec<T>::kFixed ? codec<T>::kSize : sizeof(uint64_t);
+}
+
+template <typename T>
+void _read_range(Reader& r, T* p, size_t n) {
+    if constexpr (is_packed_v<T>) {
+        if (n != 0) std::memcpy(p, r.Take(n * sizeof(T)), n * sizeof(T));
+    } else {
+        for (size_t i = 0; i < n; ++i) codec<T>::Read(r, p[i]);
+    }
+}
+
+template <typename T, typename Allocator>
+struct codec<std::vector<T, Allocator> > {
+    // the length of a vector of empty elements could not be checked
+    // against the buffer before allocating
+    static_assert(_min_size<T>() != 0,
+                  "vectors of empty types cannot be serialized");
+    using type = std::vector<T, Allocator>;
+    static constexpr bool kFixed = false;
+    static constexpr size_t kSize = 0;
+
+    static size_t Size(const type& v) {
+        return sizeof(uint64_t) + _range_size(v.data(), v.size());
+    }
+
+    static char* Write(char* dst, const type& v) {
+        _write_length(dst, v.size());
+        return _write_range(dst, v.data(), v.size());
+    }
+
+    static void Read(Reader& r, type& v) {
+        size_t n = _read_length(r);
+        // reject lengths the buffer cannot hold before allocating
+        if (n > r.Remaining() / _min_size<T>()) {
+            throw std::out_of_range("serialization: buffer too short");
+        }
+        v.resize(n);
+        _read_range(r, v.data(), n);
+    }
+};
+
+template <typename CharT, typename Traits, typename Allocator>
+struct codec<std::basic_string<CharT, Traits, Allocator> > {
+    using type = std::basic_string<CharT, Traits, Allocator>;
+    static constexpr bool kFixed = false;
+    static constexpr size_t kSize = 0;
+
+    static size_t Size(const type& v) {
+        return sizeof(uint64_t) + v.size() * sizeof(CharT);
+    }
+
+    static char* Write(char* dst, const type& v) {
+        _write_length(dst, v.size());
+        return _write_range(dst, v.data(), v.size());
+    }
+
+    static void Read(Reader& r, type& v) {
+        size_t n = _read_length(r);
+        if (n > r.Remaining() / sizeof(CharT)) {
+            throw std::out_of_range("serialization: buffer too short");
+        }
+        const char* p = r.Take(n * sizeof(CharT));
+        v.resize(n);
+        if (n != 0) std::memcpy(&v[0], p, n * sizeof(CharT));
+    }
+};
+
+template <typename T>
+struct codec<T, std::enable_if_t<is_tensor<T>::value> > {
+    using DType = typename T::type;
+    static constexpr bool kFixed = false;
+    static constexpr size_t kSize = 0;
+
+    static size_t Size(const T& v) {
+        return sizeof(uint64_t) * (1 + v.Shape_().Dims())
+            + _range_size(_data(v), v.Size());
+    }
+
+    static char* Write(char* dst, const T& v) {
+        static_assert(is_tensor<T>::dev_type == tensor::device::cpu,
+                      "only cpu tensors can be serialized");
+        const auto& shape = v.Shape_();
+        _write_length(dst, shape.Dims());
+        for (auto d : shape) _write_length(dst, d);
+        return _write_range(dst, _data(v), v.Size());
+    }
+
+    static void Read(Reader& r, T& v) {
+        // reject dims and sizes the buffer cannot hold before allocating
+        size_t dims = _read_length(r);
+        if (dims > r.Remaining() / sizeof(uint64_t)) {
+            throw std::out_of_range("serialization: buffer too short");
+        }
+        std::vector<size_t> shape(dims);
+        size_t n = 1;
+        for (auto& d : shape) {
+            d = _read_length(r);
+            if (d != 0 && n > std::numeric_limits<size_t>::max() / d) {
+                throw std::out_of_range("serialization: buffer too short");
+            }
+            n *= d;
+        }
+        if (n > r.Remaining() / sizeof(DType)) {
+            throw std::out_of_range("serialization: buffer too short");
+        }
+        tensor::Shape s(shape);
+        if (!(v.Shape_() == s)) v = T(s);
+        _read_range(r, _data(v), v.Size());
+    }
+
+ private:
+    static DType* _data(const T& v) {
+        return v.Size() != 0 ? &v[0] : nullptr;
+    }
+};
+
+template <typename... F>
+constexpr bool _all_fixed(std::tuple<F...>*) {
+    return (... && codec<F>::kFixed);
+}
+
+template <typename... F>
+constexpr size_t _sum_size(std::tuple<F...>*) {
+    return (0 + ... + codec<F>::kSize);
+}
+
+/*
+ * Aggregates, field by field with runs of packed fields coalesced
+ */
+template <typename T>
+struct codec<T, std::enable_if_t<!is_packed_v<T> && !is_tensor<T>::value &&
+                                 std::is_aggregate_v<T> > > {
+    using fields = _fields_t<T>;
+    static constexpr bool kFixed = _all_fixed(static_cast<fields*>(nullptr));
+    static constexpr size_t kSize = _sum_size(static_cast<fields*>(nullptr));
+
+    static size_t Size(const T& v) {
+        if constexpr (kFixed) {
+            (void)v;
+            return kSize;
+        } else {
+            size_t sz = 0;
+            reflection::for_each_field(v, [&sz](const auto& f) {
+                using F = std::decay_t<decltype(f)>;
+                sz += codec<F>::Size(f);
+            });
+            return sz;
+        }
+    }
+
+    static char* Write(char* dst, const T& v) {
+        // [run, run + len) are packed fields adjacent in memory
+        const char* run = nullptr;
+        size_t len = 0;
+        reflection::for_each_field(v, [&](const auto& f) {
+            using F = std::decay_t<decltype(f)>;
+            if constexpr (is_packed_v<F>) {
+                auto p = reinterpret_cast<const char*>(&f);
+                if (run && run + len == p) {
+                    len += sizeof(F);
+                    return;
+                }
+                if (run) std::memcpy(dst, run, len);
+                dst += len;
+                run = p;
+                len = sizeof(F);
+            } else {
+                if (run) std::memcpy(dst, run, len);
+                dst += len;
+                run = nullptr;
+                len = 0;
+                dst = codec<F>::Write(dst, f);
+            }
+        });
+        if (run) std::memcpy(dst, run, len);
+        return dst + len;
+    }
+
+    static void Read(Reader& r, T& v) {
+        char* run = nullptr;
+        size_t len = 0;
+        reflection::for_each_field(v, [&](auto& f) {
+            using F = std::decay_t<decltype(f)>;
+            if constexpr (is_packed_v<F>) {
+                auto p = reinterpret_cast<char*>(&f);
+                if (run && run + len == p) {
+                    len += sizeof(F);
+                    return;
+                }
+                if (run) std::memcpy(run, r.Take(len), len);
+                run = p;
+                len = sizeof(F);
+            } else {
+                if (run) std::memcpy(run, r.Take(len), len);
+                run = nullptr;
+                len = 0;
+                codec<F>::Read(r, f);
+            }
+        });
+        if (run) std::memcpy(run, r.Take(len), len);
+    }
+};
+
+/*
+ * Encoded size of v, a constant for fixed-size types
+ */
+template <typename T>
+constexpr size_t static_size_v = codec<T>::kFixed ? codec<T>::kSize : 0;
+
+template <typename T>
+size_t EncodedSize(const T& v) {
+    return codec<T>::Size(v);
+}
+
+/*
+ * Write v to dst, which must hold EncodedSize(v) bytes
+ */
+template <typename T>
+char* EncodeTo(char* dst, const T& v) {
+    return codec<T>::Write(dst, v);
+}
+
+/*
+ * Append v to out, growing it once
+ */
+template <typename T>
+void Encode(const T& v, std::vector<char>& out) {
+    size_t offset = out.size();
+    out.resize(offset + EncodedSize(v));
+    EncodeTo(out.data() + offset, v);
+}
+
+template <typename T>
+std::vector<char> Encode(const T& v) {
+    std::vector<char> out;
+    Encode(v, out);
+    return out;
+}
+
+/*
+ * Read v from [first, last), returns the end of what was read
+ */
+template <typename T>
+const char* DecodeFrom(const char* first, const char* last, T& v) {
+    Reader r(first, last);
+    codec<T>::Read(r, v);
+    return r.Position();
+}
+
+template <typename T>
+T Decode(const char* data, size_t n) {
+    T v{};
+    DecodeFrom(data, data + n, v);
+    return v;
+}
+
+template <typename T>
+T Decode(const std::vector<char>& buf) {
+    return Decode<T>(buf.data(), buf.size());
+}
+
+}; // namespace serialization
+
+}; // namespace mou
+
+#endif // MOU_SERIALIZATION_H
@@ -0,0 +1,295 @@
+#ifndef MOU_SOA_H
+#define MOU_SOA_H
+
+/*
+ * \brief: structure-of-arrays container built on aggregate reflection
+ *
+ * Every field of an aggregate T is kept in its own column, aligned to
+ * kColumnAlignment, and each column can be used as an expr::Vec.
+ * Fields must be trivially copyable.
+ *
+ * Example:
+ *  struct particle { float x; float v; int id; };
+ *  std::vector<particle> aos = ...;
+ *  auto soa = SoAVector<particle>::FromAoS(aos.data(), aos.size());
+ *  auto x = soa.Column<0>();
+ *  x = x + soa.Column<1>();
+ *  soa[3].get<2>() = 7;
+ *  particle p = soa[3];
+ */
+
+#include "expression.h"
+#include "reflection.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace mou {
+
+namespace soa {
+
+constexpr size_t kColumnAlignment = 64;
+// records converted per block, so a block stays in cache across columns
+constexpr size_t kConvertBlock = 256;
+
+template <typename T>
+class SoAVector {
+ public:
+    using value_type = T;
+    static constexpr size_t kNumFields = reflection::field_count_v<T>;
+
+    template <size_t I>
+    using field_type = reflection::field_t<I, T>;
+
+ private:
+    using fields = decltype(reflection::tuple_binding(std::declval<const T&>()));
+    using indices = std::make_index_sequence<kNumFields>;
+
+    template <typename... F>
+    static std::tuple<F*...> _columns_of(std::tuple<F...>*);
+
+    using columns_t = decltype(_columns_of(static_cast<fields*>(nullptr)));
+
+    static_assert(std::is_aggregate_v<T>, "SoAVector needs an aggregate");
+    static_assert(kNumFields > 0, "SoAVector needs at least one field");
+
+ public:
+    /*
+     * Proxy for the i-th record, reads and writes go to the columns
+     */
+    class reference {
+     public:
+        reference(SoAVector* v, size_t i) : v(v), i(i) {}
+
+        template <size_t I>
+        field_type<I>& get() const {
+            return std::get<I>(v->columns)[i];
+        }
+
+        operator T() const {
+            return v->Get(i);
+        }
+
+        reference& operator = (const T& src) {
+            v->Set(i, src);
+            return *this;
+        }
+
+        reference& operator = (const reference& src) {
+            v->Set(i, static_cast<T>(src));
+            return *this;
+        }
+
+     private:
+        SoAVector* v;
+        size_t i;
+    };
+
+    SoAVector() : len(0), cap(0) {
+        _for_each_column([](auto*& col) { col = nullptr; });
+    }
+
+    explicit SoAVector(size_t n) : SoAVector() {
+        Resize(n);
+    }
+
+    SoAVector(const SoAVector& src) : SoAVector() {
+        _reallocate(src.len);
+        len = src.len;
+        _copy_columns(src.columns, columns, len);
+    }
+
+    SoAVector(SoAVector&& src) noexcept
+        : columns(src.columns), len(src.len), cap(src.cap) {
+        src._for_each_column([](auto*& col) { col = nullptr; });
+        src.len = src.cap = 0;
+    }
+
+    SoAVector& operator = (SoAVector src) noexcept {
+        std::swap(columns, src.columns);
+        std::swap(len, src.len);
+        std::swap(cap, src.cap);
+        return *this;
+    }
+
+    ~SoAVector() {
+        _for_each_column([](auto*& col) { _deallocate(col); });
+    }
+
+    /*
+     * Bulk conversion from an array of structs
+     */
+    static SoAVector FromAoS(const T* first, size_t n) {
+        SoAVector v;
+        v.Assign(first, n);
+        return v;
+    }
+
+    void Assign(const T* first, size_t n) {
+        if (n > cap) _reallocate(n);
+        len = n;
+        for (size_t b = 0; b < n; b += kConvertBlock) {
+            size_t e = std::min(n, b + kConvertBlock);
+            _scatter(first + b, b, e, indices());
+        }
+    }
+
+    /*
+     * Bulk conversion to an array of structs, out must hold Size() records
+     */
+    void ToAoS(T* out) const {
+        for (size_t b = 0; b < len; b += kConvertBlock) {
+            size_t e = std::min(len, b + kConvertBlock);
+            _gather(out + b, b, e, indices());
+        }
+    }
+
+    inline size_t Size() const {
+        return len;
+    }
+
+    inline size_t Capacity() const {
+        return cap;
+    }
+
+    void Reserve(size_t n) {
+        if (n > cap) _reallocate(n);
+    }
+
+    // new records are value-initialized
+    void Resize(size_t n) {
+        Reserve(n);
+        if (n > len) {
+            _for_each_column([this, n](auto* col) {
+                std::fill(col + len, col + n,
+                          std::remove_pointer_t<decltype(col)>());
+            });
+        }
+        len = n;
+    }
+
+    void PushBack(const T& src) {
+        if (len == cap) _reallocate(std::max<size_t>(2 * cap, 16));
+        ++len;
+        Set(len - 1, src);
+    }
+
+    reference operator [] (size_t i) {
+        assert(i < len);
+        return reference(this, i);
+    }
+
+    T operator [] (size_t i) const {
+        return Get(i);
+    }
+
+    T Get(size_t i) const {
+        T out{};
+        _gather(&out, i, i + 1, indices());
+        return out;
+    }
+
+    void Set(size_t i, const T& src) {
+        _scatter(&src, i, i + 1, indices());
+    }
+
+    template <size_t I>
+    inline field_type<I>* Data() const {
+        return std::get<I>(columns);
+    }
+
+    /*
+     * Column I as a vector expression
+     */
+    template <size_t I>
+    inline expr::Vec<field_type<I> > Column() const {
+        return expr::Vec<field_type<I> >(std::get<I>(columns), len);
+    }
+
+ private:
+    template <typename Fn>
+    void _for_each_column(Fn&& f) {
+        std::apply([&f](auto*&... col) { (f(col), ...); }, columns);
+    }
+
+    template <typename F>
+    static F* _allocate(size_t n) {
+        static_assert(std::is_trivially_copyable_v<F>,
+                      "SoAVector fields must be trivially copyable");
+        return static_cast<F*>(::operator new(
+                    n * sizeof(F), std::align_val_t(kColumnAlignment)));
+    }
+
+    template <typename F>
+    static void _deallocate(F* p) {
+        if (p) ::operator delete(p, std::align_val_t(kColumnAlignment));
+    }
+
+    static void _copy_columns(const columns_t& src, columns_t& dst, size_t n) {
+        _copy_columns(src, dst, n, indices());
+    }
+
+    template <size_t... I>
+    static void _copy_columns(const columns_t& src, columns_t& dst, size_t n,
+                              std::index_sequence<I...>) {
+        if (n == 0) return;
+        (std::memcpy(std::get<I>(dst), std::get<I>(src),
+                     n * sizeof(field_type<I>)), ...);
+    }
+
+    void _reallocate(size_t n) {
+        columns_t fresh;
+        std::apply([n](auto*&... col) {
+            ((col = _allocate<std::remove_pointer_t<
+                        std::remove_reference_t<decltype(col)> > >(n)), ...);
+        }, fresh);
+        _copy_columns(columns, fresh, len);
+        _for_each_column([](auto*& col) { _deallocate(col); });
+        columns = fresh;
+        cap = n;
+    }
+
+    // src[0, e - b) -> rows [b, e), one column at a time
+    template <size_t... I>
+    void _scatter(const T* src, size_t b, size_t e,
+                  std::index_sequence<I...>) {
+        (_scatter_column<I>(src, b, e), ...);
+    }
+
+    template <size_t I>
+    void _scatter_column(const T* src, size_t b, size_t e) {
+        auto* col = std::get<I>(columns);
+        for (size_t i = b; i < e; ++i) {
+            col[i] = std::get<I>(reflection::ctie_binding(src[i - b]));
+        }
+    }
+
+    // rows [b, e) -> dst[0, e - b), one column at a time
+    template <size_t... I>
+    void _gather(T* dst, size_t b, size_t e, std::index_sequence<I...>) const {
+        (_gather_column<I>(dst, b, e), ...);
+    }
+
+    template <size_t I>
+    void _gather_column(T* dst, size_t b, size_t e) const {
+        const auto* col = std::get<I>(columns);
+        for (size_t i = b; i < e; ++i) {
+            std::get<I>(reflection::tie_binding(dst[i - b])) = col[i];
+        }
+    }
+
+ private:
+    columns_t columns;
+    size_t len;
+    size_t cap;
+};
+
+}; // namespace soa
+
+}; // namespace mou
+
+#endif // MOU_SOA_H
@@ -0,0 +1,226 @@
+#ifndef MOU_STATIC_TENSOR_H
+#define MOU_STATIC_TENSOR_H
+
+/*
+ * \brief: tensor with a compile-time shape and inline storage
+ *
+ * StaticTensor never allocates. It takes part in expressions like Tensor,
+ * and assignments, Dot and MatMul are unrolled at compile time for up to
+ * kMaxUnroll elements.
+ *
+ * Example:
+ *  StaticTensor<float, 3, 3> r{0, -1, 0,
+ *                              1,  0, 0,
+ *                              0,  0, 1};
+ *  StaticTensor<float, 3> p{1, 2, 3}, q;
+ *  q = MatMul(r, p);
+ *  q = q * 2 + p;
+ */
+
+#include "expression.h"
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace mou {
+
+namespace tensor {
+
+// larger tensors are assigned with a loop
+constexpr size_t kMaxUnroll = 64;
+constexpr size_t kStaticAlignment = 32;
+
+// largest power of two dividing `bytes`, between `align` and the maximum,
+// so that alignment never adds padding
+constexpr size_t _static_alignment(size_t bytes, size_t align) {
+    while (align < kStaticAlignment && bytes % (2 * align) == 0) align *= 2;
+    return align;
+}
+
+template <typename DType, size_t... Dims>
+class StaticTensor : public expr::Exp<StaticTensor<DType, Dims...> > {
+ public:
+    using type = DType;
+    // expressions refer to tensors instead of copying them
+    using container_tag = void;
+
+    static constexpr size_t kDims = sizeof...(Dims);
+    static constexpr size_t kSize = (size_t(1) * ... * Dims);
+    static constexpr std::array<size_t, kDims> kShape{{Dims...}};
+
+    static_assert(kDims > 0 && kSize > 0, "StaticTensor needs a shape");
+
+    constexpr StaticTensor() : data{} {}
+
+    constexpr StaticTensor(std::initializer_list<DType> l) : data{} {
+        if (l.size() != kSize) {
+            throw std::invalid_argument("StaticTensor: wrong list size");
+        }
+        size_t i = 0;
+        for (auto v : l) data[i++] = v;
+    }
+
+    template <typename EType>
+    StaticTensor(const expr::Exp<EType> &src) : data{} {
+        (*this) = src;
+    }
+
+    template <typename EType>
+    inline StaticTensor& operator = (const expr::Exp<EType> &src) {
+        const EType &src_ = src.self();
+        if constexpr (kSize <= kMaxUnroll) {
+            _assign(src_, std::make_index_sequence<kSize>());
+        } else {
+            expr::EvalRange(data, src_, 0, kSize);
+        }
+        return *this;
+    }
+
+    template <typename EType,
+              typename = typename std::enable_if_t<std::is_scalar_v<EType>>>
+    inline StaticTensor& operator = (const EType &src) {
+        (*this) = expr::ScalarMapExp<EType>(src);
+        return *this;
+    }
+
+    constexpr DType& operator [] (size_t i) {
+        return data[i];
+    }
+
+    constexpr const DType& operator [] (size_t i) const {
+        return data[i];
+    }
+
+    template <typename... I,
+              typename = std::enable_if_t<sizeof...(I) == kDims> >
+    constexpr DType& operator () (I... idx) {
+        return data[_offset(idx...)];
+    }
+
+    template <typename... I,
+              typename = std::enable_if_t<sizeof...(I) == kDims> >
+    constexpr const DType& operator () (I... idx) const {
+        return data[_offset(idx...)];
+    }
+
+    inline DType Eval(expr::index_t i) const {
+        return data[i];
+    }
+
+    constexpr DType* Data() {
+        return data;
+    }
+
+    constexpr const DType* Data() const {
+        return data;
+    }
+
+    static constexpr size_t Dims_() {
+        return kDims;
+    }
+
+    static constexpr size_t Size() {
+        return kSize;
+    }
+
+    static constexpr size_t Size(size_t i) {
+        return kShape[i];
+    }
+
+ private:
+    template <typename EType, size_t... I>
+    inline void _assign(const EType &src, std::index_sequence<I...>) {
+        ((data[I] = src.Eval(I)), ...);
+    }
+
+    template <typename... I>
+    static constexpr size_t _offset(I... idx) {
+        size_t off = 0, d = 0;
+        ((off = off * kShape[d++] + static_cast<size_t>(idx)), ...);
+        return off;
+    }
+
+ private:
+    alignas(_static_alignment(kSize * sizeof(DType), alignof(DType)))
+    DType data[kSize];
+};
+
+template <typename DType, size_t... Dims, size_t... I>
+inline DType _dot(const StaticTensor<DType, Dims...>& a,
+                  const StaticTensor<DType, Dims...>& b,
+                  std::index_sequence<I...>) {
+    return (DType(0) + ... + (a[I] * b[I]));
+}
+
+template <typename DType, size_t... Dims>
+inline DType Dot(const StaticTensor<DType, Dims...>& a,
+                 const StaticTensor<DType, Dims...>& b) {
+    using T = StaticTensor<DType, Dims...>;
+    if constexpr (T::kSize <= kMaxUnroll) {
+        return _dot(a, b, std::make_index_sequence<T::kSize>());
+    } else {
+        DType sum = 0;
+        for (size_t i = 0; i < T::kSize; ++i) sum += a[i] * b[i];
+        return sum;
+    }
+}
+
+// sum over k of a(i, k) * b(k, j), with `a` row-major of K columns and
+// `b` row-major of N columns
+template <size_t K, size_t N, typename DType, size_t... k>
+inline DType _mat_mul_at(const DType* a, const DType* b, size_t i, size_t j,
+                         std::index_sequence<k...>) {
+    return (DType(0) + ... + (a[i * K + k] * b[k * N + j]));
+}
+
+template <size_t M, size_t K, size_t N, typename DType, size_t... I>
+inline void _mat_mul(const DType* a, const DType* b, DType* c,
+                     std::index_sequence<I...>) {
+    ((c[I] = _mat_mul_at<K, N>(a, b, I / N, I % N,
+                               std::make_index_sequence<K>())), ...);
+}
+
+template <size_t M, size_t K, size_t N, typename DType>
+inline void _mat_mul(const DType* a, const DType* b, DType* c) {
+    if constexpr (M * N * K <= kMaxUnroll * 4) {
+        _mat_mul<M, K, N>(a, b, c, std::make_index_sequence<M * N>());
+    } else {
+        for (size_t i = 0; i < M; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                DType sum = 0;
+                for (size_t k = 0; k < K; ++k) {
+                    sum += a[i * K + k] * b[k * N + j];
+                }
+                c[i * N + j] = sum;
+            }
+        }
+    }
+}
+
+/*
+ * Matrix product of (M, K) and (K, N), or of (M, K) and a vector of K
+ */
+template <typename DType, size_t M, size_t K, size_t N>
+inline StaticTensor<DType, M, N> MatMul(const StaticTensor<DType, M, K>& a,
+                                        const StaticTensor<DType, K, N>& b) {
+    StaticTensor<DType, M, N> c;
+    _mat_mul<M, K, N>(a.Data(), b.Data(), c.Data());
+    return c;
+}
+
+template <typename DType, size_t M, size_t K>
+inline StaticTensor<DType, M> MatMul(const StaticTensor<DType, M, K>& a,
+                                     const StaticTensor<DType, K>& b) {
+    StaticTensor<DType, M> c;
+    _mat_mul<M, K, 1>(a.Data(), b.Data(), c.Data());
+    return c;
+}
+
+}; // namespace tensor
+
+}; // namespace mou
+
+#endif // MOU_STATIC_TENSOR_H
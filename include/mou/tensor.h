@@ -1,17 +1,25 @@
 #ifndef MOU_TENSOR_H
 #define MOU_TENSOR_H
 
+#include "autotune.h"
 #include "expression.h"
+#include "memory.h"
+#include "parallel.h"
+#include "profiler.h"
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <cstring>
 #include <functional>
 #include <initializer_list>
 #include <iomanip>
 #include <memory>
 #include <numeric>
+#include <iterator>
 #include <ostream>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -20,62 +28,101 @@ namespace mou {
 
 namespace tensor {
 
+// shapes of up to kInlineDims dimensions never allocate
+constexpr size_t kInlineDims = 8;
+
 template <typename DType>
 class ShapeBase {
  public:
-    template <typename... T>
+    using const_iterator = const DType*;
+    using const_reverse_iterator = std::reverse_iterator<const DType*>;
+
+    template <typename... T,
+              typename = std::enable_if_t<(... && std::is_arithmetic_v<T>)> >
     explicit ShapeBase(T ...args) {
-        shape = {static_cast<DType>(args)...};
-        len = (... * static_cast<DType>(args));
+        const DType dims[] = {static_cast<DType>(args)...};
+        _assign(dims, sizeof...(args));
     }
 
     explicit ShapeBase() {
-        shape = {};
+        _assign(nullptr, 0);
         len = 0;
     }
 
     ShapeBase(std::initializer_list<DType> l) {
-        shape = l;
-        len =  _get_shape_length(shape);
+        _assign(l.begin(), l.size());
     }
 
-    explicit ShapeBase(std::vector<size_t> src) {
-        shape = src;
-        len =  _get_shape_length(shape);
+    explicit ShapeBase(const std::vector<size_t>& src) {
+        _assign(src.data(), src.size());
+    }
+
+    ShapeBase(const DType* first, const DType* last) {
+        _assign(first, last - first);
+    }
+
+    ShapeBase(const ShapeBase& src) {
+        _assign(src.data, src.ndim);
+        len = src.len;
+    }
+
+    ShapeBase(ShapeBase&& src) noexcept {
+        _steal(src);
+    }
+
+    ~ShapeBase() {
+        _release();
+    }
+
+    ShapeBase& operator = (const ShapeBase& src) {
+        if (this != &src) {
+            _release();
+            _assign(src.data, src.ndim);
+            len = src.len;
+        }
+        return *this;
+    }
+
+    ShapeBase& operator = (ShapeBase&& src) noexcept {
+        if (this != &src) {
+            _release();
+            _steal(src);
+        }
+        return *this;
     }
 
     DType operator [] (size_t i) const {
-        return shape.at(i);
+        return this->Size(i);
     }
 
     bool operator == (const ShapeBase& other) const {
-        return shape == other.shape;
+        return ndim == other.ndim && std::equal(begin(), end(), other.begin());
     }
 
     ShapeBase& operator = (std::initializer_list<DType> l) {
-        shape = l;
-        len =  _get_shape_length(shape);
+        _release();
+        _assign(l.begin(), l.size());
         return *this;
     }
 
-    const auto begin() const noexcept {
-        return shape.begin();
+    const_iterator begin() const noexcept {
+        return data;
     }
 
-    const auto end() const noexcept {
-        return shape.end();
+    const_iterator end() const noexcept {
+        return data + ndim;
     }
 
-    const auto rbegin() const noexcept {
-        return shape.rbegin();
+    const_reverse_iterator rbegin() const noexcept {
+        return const_reverse_iterator(end());
     }
 
-    const auto rend() const noexcept {
-        return shape.rend();
+    const_reverse_iterator rend() const noexcept {
+        return const_reverse_iterator(begin());
     }
 
     inline DType Dims() const {
-        return shape.size();
+        return ndim;
     }
 
     inline DType Size() const {
@@ -83,25 +130,46 @@ class ShapeBase {
     }
 
     inline DType Size(size_t i) const {
-        return shape.at(i);
+        if (i >= ndim) throw std::out_of_range("ShapeBase: no such dimension");
+        return data[i];
     }
 
     inline DType Size(size_t start, size_t end) const {
         DType sz = 1;
         for (size_t i = start; i < end; ++i) {
-            sz *= shape.at(i);
+            sz *= this->Size(i);
         }
         return sz;
     }
 
     inline DType SizeFrom(size_t start) const {
-        return this->Size(start, this->Dims());
+        if (start >= ndim) return 1;
+        return start == 0 ? len : _strides()[start - 1];
     }
 
     inline DType SizeTo(size_t end) const {
         return this->Size(0, end);
     }
 
+    /*
+     * Elements between neighbours along dimension i, in row-major order
+     */
+    inline DType Stride(size_t i) const {
+        if (i >= ndim) throw std::out_of_range("ShapeBase: no such dimension");
+        return _strides()[i];
+    }
+
+    /*
+     * Copy of this shape with dimension i set to n
+     */
+    ShapeBase With(size_t i, DType n) const {
+        if (i >= ndim) throw std::out_of_range("ShapeBase: no such dimension");
+        ShapeBase out(*this);
+        out.data[i] = n;
+        out._update();
+        return out;
+    }
+
     friend std::ostream& operator << (std::ostream& os, const ShapeBase& other) {
         os << '(';
         for (size_t i = 0; i < other.Dims(); ++i) {
@@ -114,14 +182,53 @@ class ShapeBase {
     }
 
  private:
-    inline DType _get_shape_length(std::vector<DType> _shape) const {
-        return std::accumulate(_shape.begin(), _shape.end(),
-                               1, std::multiplies<>());
+    // dims followed by strides, inline up to kInlineDims dimensions
+    void _assign(const DType* first, size_t n) {
+        ndim = n;
+        data = n <= kInlineDims ? storage : new DType[2 * n];
+        std::copy(first, first + n, data);
+        _update();
+    }
+
+    void _update() {
+        DType* strides = data + ndim;
+        DType stride = 1;
+        for (size_t i = ndim; i-- > 0;) {
+            strides[i] = stride;
+            stride *= data[i];
+        }
+        len = stride;
+    }
+
+    inline const DType* _strides() const {
+        return data + ndim;
+    }
+
+    // leaves src empty, like a moved-from vector
+    void _steal(ShapeBase& src) {
+        if (src.data == src.storage) {
+            _assign(src.data, src.ndim);
+            len = src.len;
+        } else {
+            data = src.data;
+            ndim = src.ndim;
+            len = src.len;
+            src.data = src.storage;
+        }
+        src.ndim = 0;
+        src.len = 0;
+    }
+
+    void _release() {
+        if (data != storage) delete[] data;
+        data = storage;
     }
 
  private:
-    std::vector<DType> shape;
+    DType* data;
+    size_t ndim;
     DType len;
+    DType storage[2 * kInlineDims];
 };
 
 using Shape = ShapeBase<size_t>;
@@ -157,11 +264,122 @@ struct copy_to_dev<InputIt, ForwardIt, device::cpu, device::cpu> {
     }
 };
 
+/*
+ * Allocators declaring `parallel_first_touch = true` get their memory
+ * initialized in parallel, part k of the tensor by worker k of the pool
+ */
+template <typename Allocator, typename = void>
+struct parallel_first_touch : std::false_type {};
+
+template <typename Allocator>
+struct parallel_first_touch<Allocator,
+    std::enable_if_t<Allocator::parallel_first_touch> > : std::true_type {};
+
+/*
+ * Tensors evaluate expressions of EvalParams().parallel_threshold elements
+ * or more on the thread pool when their allocator declares
+ * `parallel_eval = true` or a parallel first-touch, and on the calling
+ * thread otherwise. Leaves and the callables of F(fn, ...) assigned to
+ * such tensors run concurrently on worker threads.
+ */
+template <typename Allocator, typename = void>
+struct parallel_eval : parallel_first_touch<Allocator> {};
+
+template <typename Allocator>
+struct parallel_eval<Allocator,
+    std::enable_if_t<Allocator::parallel_eval> > : std::true_type {};
+
+// std::allocator opting in to parallel evaluation
+template <typename DType>
+struct parallel_allocator : public std::allocator<DType> {
+    static constexpr bool parallel_eval = true;
+
+    template <typename U>
+    struct rebind {
+        using other = parallel_allocator<U>;
+    };
+
+    parallel_allocator() noexcept = default;
+
+    template <typename U>
+    parallel_allocator(const parallel_allocator<U>&) noexcept {}
+};
+
+// widest SIMD register, alignment that lets kernels use aligned loads
+constexpr size_t kSimdAlignment = 64;
+
+// tag of the constructor that uses an external buffer without owning it
+struct borrow_t {
+    explicit borrow_t() = default;
+};
+inline constexpr borrow_t borrow{};
+
+// expressions smaller than this are evaluated by the calling thread
+constexpr size_t kEvalParallelThreshold = 1 << 16;
+constexpr size_t kEvalGrain = 1 << 14;
+
+/*
+ * Loop parameters of expression evaluation, the defaults above unless
+ * autotuning is enabled
+ */
+struct eval_params {
+    size_t parallel_threshold = kEvalParallelThreshold;
+    size_t grain = kEvalGrain;
+};
+
+// y = 2 * x + y over n elements, in chunks of `grain` on the pool
+inline void _axpy_bench(float* x, float* y, size_t n, size_t grain) {
+    parallel::ParallelFor(0, n, grain, [=](size_t begin, size_t end) {
+        expr::Vec<float> vx(x, n), vy(y, n);
+        expr::EvalRange(y, vy + vx * 2.f, begin, end);
+    });
+}
+
+inline eval_params _tune_eval_params() {
+    eval_params p;
+    size_t workers = parallel::ThreadPool::Get().NumWorkers();
+    if (!autotune::Enabled() || workers == 0) return p;
+
+    std::string suffix = ".t" + std::to_string(workers);
+    const size_t n = 1 << 22;
+    std::vector<float> x(n, 1.f), y(n, 0.f);
+    p.grain = autotune::Choose("eval.grain" + suffix,
+        {1 << 12, 1 << 13, 1 << 14, 1 << 15, 1 << 16, 1 << 17},
+        [&](size_t grain) {
+            return autotune::Time([&] {
+                _axpy_bench(x.data(), y.data(), n, grain);
+            });
+        });
+    // small sizes are repeated to about n elements, for stable timings
+    auto batch = [&](size_t m, size_t grain) {
+        return autotune::Time([&] {
+            for (size_t r = 0; r < n / m; ++r) {
+                _axpy_bench(x.data(), y.data(), m, grain);
+            }
+        });
+    };
+    p.parallel_threshold = autotune::Crossover(
+        "eval.parallel_threshold" + suffix,
+        {1 << 12, 1 << 13, 1 << 14, 1 << 15, 1 << 16, 1 << 17, 1 << 18},
+        [&](size_t m) { return batch(m, m); },
+        [&](size_t m) { return batch(m, (m + workers) / (workers + 1)); });
+    return p;
+}
+
+// tuned on first use
+inline const eval_params& EvalParams() {
+    static const eval_params p = _tune_eval_params();
+    return p;
+}
+
 template <typename DType, int DevType=device::cpu, int DevId=0,
           typename Allocator = std::allocator<DType> >
-class Tensor : public expr::Exp<Tensor<DType> > {
+class Tensor
+    : public expr::Exp<Tensor<DType, DevType, DevId, Allocator> > {
  public:
     using type = DType;
+    // expressions refer to tensors instead of copying them
+    using container_tag = void;
     device dev = static_cast<device>(DevType);
     int dev_id = DevId;
 
@@ -171,10 +389,18 @@ class Tensor : public expr::Exp<Tensor<DType> > {
     pointer dptr;
     Allocator alloc;
     Shape shape;
+    // external buffers are released by `deleter`, or not at all if empty
+    bool external = false;
+    std::function<void(pointer)> deleter;
 
  public:
     explicit Tensor(Shape _shape) : shape(std::move(_shape)) {
         dptr = _M_allocate(this->Size());
+        if constexpr (parallel_first_touch<Allocator>::value) {
+            _M_parallel(this->Size(), [this](size_t begin, size_t end) {
+                std::uninitialized_value_construct(dptr + begin, dptr + end);
+            });
+        }
     }
 
     // TODO(Chenxia Han): Constructor with nested initializer_list
@@ -187,16 +413,35 @@ class Tensor : public expr::Exp<Tensor<DType> > {
     // only support memory resource with the same device type
     explicit Tensor(pointer first, pointer last, Shape _shape)
         : shape(std::move(_shape)) {
-        assert(last-first == _shape.Size());
+        assert(static_cast<size_t>(last - first) == shape.Size());
         dptr = _M_allocate_and_copy<DevType>(first, last);
     }
 
+    /*
+     * Adopt an external buffer of shape.Size() elements without copying,
+     * deleter(p) is called when the tensor releases it. The buffer must
+     * be aligned for DType; vectorized loops then apply as for allocated
+     * tensors, and IsAligned() tells whether wider aligned loads do.
+     */
+    Tensor(pointer p, Shape _shape, std::function<void(pointer)> _deleter)
+        : dptr(p), shape(std::move(_shape)), external(true),
+          deleter(std::move(_deleter)) {
+        _M_check_external();
+    }
+
+    // use an external buffer that outlives the tensor, never released
+    Tensor(pointer p, Shape _shape, borrow_t)
+        : dptr(p), shape(std::move(_shape)), external(true) {
+        _M_check_external();
+    }
+
     ~Tensor() {
-        _M_deallocate(dptr, this->Size());
+        _M_release();
     }
 
     // only support tensor in the same device type
     Tensor(const Tensor& src) {
+        MOU_PROFILE_SCOPE(profiler::op::copy, src.Size() * sizeof(DType), 0);
         shape = src.shape;
         dptr = _M_allocate_and_copy<DevType>(src.dptr, src.dptr + src.Size());
     }
@@ -204,14 +449,16 @@ class Tensor : public expr::Exp<Tensor<DType> > {
     Tensor(Tensor&& src) noexcept {
         shape = std::move(src.shape);
         dptr = _M_allocate_on_move(src.dptr);
+        _M_take_external(src);
     }
 
     // only support tensor in the same device type
     Tensor& operator = (const Tensor& src) {
+        MOU_PROFILE_SCOPE(profiler::op::copy, src.Size() * sizeof(DType), 0);
         if (shape == src.shape) {
             _M_copy<DevType>(src.dptr, src.dptr + src.Size(), dptr);
         } else {
-            _M_deallocate(dptr, this->Size());
+            _M_release();
             shape = src.shape;
             dptr = _M_allocate_and_copy<DevType>(src.dptr, src.dptr + src.Size());
         }
@@ -220,9 +467,10 @@ class Tensor : public expr::Exp<Tensor<DType> > {
     }
 
     Tensor& operator = (Tensor&& src) noexcept {
-        _M_deallocate(dptr, this->Size());
+        _M_release();
         shape = std::move(src.shape);
         dptr = _M_allocate_on_move(src.dptr);
+        _M_take_external(src);
 
         return *this;
     }
@@ -231,7 +479,7 @@ class Tensor : public expr::Exp<Tensor<DType> > {
         if (shape == Shape(l.size())) {
             _M_copy<device::cpu>(l.begin(), l.end(), dptr);
         } else {
-            _M_deallocate(dptr, this->Size());
+            _M_release();
             shape = {l.size()};
             // initializer_list must store in cpu
             dptr = _M_allocate_and_copy<device::cpu>(l.begin(), l.end());
@@ -244,12 +492,15 @@ class Tensor : public expr::Exp<Tensor<DType> > {
         return dptr[i];
     }
 
+    // large expressions run on the thread pool if parallel_eval<Allocator>
     template <typename EType>
     inline Tensor& operator = (const expr::Exp<EType> &src) {
+        MOU_PROFILE_SCOPE(profiler::op::eval,
+                          this->Size() * sizeof(DType), this->Size());
         const EType &src_ = src.self();
-        for (int i = 0; i < this->Size(); ++i) {
-            dptr[i] = src_.Eval(i);
-        }
+        _M_parallel(this->Size(), [this, &src_](size_t begin, size_t end) {
+            expr::EvalRange(dptr, src_, begin, end);
+        });
         return *this;
     }
 
@@ -261,14 +512,27 @@ class Tensor : public expr::Exp<Tensor<DType> > {
         return *this;
     }
 
-    inline DType Eval(int i) const {
+    inline DType Eval(expr::index_t i) const {
         return dptr[i];
     }
 
-    inline Shape Shape_() const {
+    inline pointer Data() const {
+        return dptr;
+    }
+
+    inline const Shape& Shape_() const {
         return shape;
     }
 
+    // whether the buffer is adopted or borrowed rather than allocated
+    inline bool External() const {
+        return external;
+    }
+
+    inline bool IsAligned(size_t alignment = kSimdAlignment) const {
+        return reinterpret_cast<std::uintptr_t>(dptr) % alignment == 0;
+    }
+
     inline size_t Size() const {
         return shape.Size();
     }
@@ -296,13 +560,10 @@ class Tensor : public expr::Exp<Tensor<DType> > {
         assert(slice_len > 0 && begin >= 0);
 
         auto n = shape.SizeFrom(1);
-        std::vector<size_t> slice_shape;
-        slice_shape.push_back(slice_len);
-        for (int i = 1; i < shape.Dims(); ++i) {
-            slice_shape.push_back(shape[i]);
-        }
-
-        return Tensor(dptr + begin * n, dptr + end * n, Shape(slice_shape));
+        MOU_PROFILE_SCOPE(profiler::op::slice,
+                          slice_len * n * sizeof(DType), 0);
+        return Tensor(dptr + begin * n, dptr + end * n,
+                      shape.With(0, slice_len));
     }
 
     inline Tensor SliceFrom(size_t begin) const {
@@ -394,22 +655,83 @@ class Tensor : public expr::Exp<Tensor<DType> > {
  private:
     pointer _M_allocate(size_t n) {
         using alloc_traits = std::allocator_traits<Allocator>;
-        return n != 0 ? alloc_traits::allocate(alloc, n) : pointer();
+        MOU_PROFILE_SCOPE(profiler::op::allocate, n * sizeof(DType), 0);
+        pointer p = n != 0 ? alloc_traits::allocate(alloc, n) : pointer();
+        MOU_MEMORY_ON_ALLOCATE(DType, Allocator, DevType, DevId, p, n, shape);
+        return p;
     }
 
     void _M_deallocate(pointer p, size_t n) {
         using alloc_traits = std::allocator_traits<Allocator>;
         if (p) {
+            MOU_PROFILE_SCOPE(profiler::op::deallocate, n * sizeof(DType), 0);
+            MOU_MEMORY_ON_DEALLOCATE(DType, Allocator, DevType, DevId, p, n);
             alloc_traits::deallocate(alloc, p, n);
         }
     }
 
+    // release the buffer, which assigning or moving may replace by an
+    // allocated one
+    void _M_release() {
+        if (!external) {
+            _M_deallocate(dptr, this->Size());
+            return;
+        }
+        if (dptr && deleter) deleter(dptr);
+        external = false;
+        deleter = nullptr;
+    }
+
+    void _M_take_external(Tensor& src) {
+        external = src.external;
+        deleter = std::move(src.deleter);
+        src.external = false;
+        src.deleter = nullptr;
+    }
+
+    void _M_check_external() const {
+        if (!dptr && this->Size() != 0) {
+            throw std::invalid_argument("external buffer is null");
+        }
+        if (!IsAligned(alignof(DType))) {
+            throw std::invalid_argument("external buffer is misaligned");
+        }
+    }
+
+    // large loops run on the thread pool for allocators opting in,
+    // partitioned like the memory of first-touch allocators
+    template <typename Fn>
+    void _M_parallel(size_t n, Fn&& f) const {
+        if constexpr (!parallel_eval<Allocator>::value) {
+            f(0, n);
+            return;
+        }
+        const eval_params& p = EvalParams();
+        if (n < p.parallel_threshold) {
+            f(0, n);
+        } else if constexpr (parallel_first_touch<Allocator>::value) {
+            parallel::ParallelForStatic(0, n, f);
+        } else {
+            parallel::ParallelFor(0, n, p.grain, f);
+        }
+    }
+
     template <int ForwardDevType, typename ForwardIterator>
     pointer _M_allocate_and_copy(ForwardIterator first,
             ForwardIterator last) {
         auto n = last - first;
         pointer result = _M_allocate(n);
         try {
+            if constexpr (parallel_first_touch<Allocator>::value &&
+                          ForwardDevType == device::cpu &&
+                          DevType == device::cpu) {
+                _M_parallel(n, [first, result](size_t begin, size_t end) {
+                    uninit_copy_to_dev<ForwardIterator, pointer,
+                                       device::cpu, device::cpu>
+                        ::Copy(first + begin, first + end, result + begin);
+                });
+                return result;
+            }
             uninit_copy_to_dev<ForwardIterator, pointer, ForwardDevType, DevType>
                 ::Copy(first, last, result);
             return result;
@@ -0,0 +1,265 @@
+#ifndef MOU_TENSOR_INDEX_H
+#define MOU_TENSOR_INDEX_H
+
+/*
+ * \brief: gather, scatter-add, concat and split along a tensor axis
+ *
+ * A tensor is seen as (outer, axis, inner): every operation moves rows
+ * of `inner` contiguous elements. Rows are copied in parallel, and the
+ * rows picked by indices are prefetched a few rows ahead, since random
+ * rows of a large table defeat the hardware prefetcher.
+ *
+ * Gather and Concat can write into a preallocated destination. Indices
+ * are any integer tensor, e.g. from ArgSort, and are checked before any
+ * element is written.
+ *
+ * Example:
+ *  Tensor<float> table{Shape(100000, 256)};
+ *  Tensor<int64_t> ids{17, 4, 99871};
+ *  auto batch = Gather(table, ids, 0);     // (3, 256)
+ *  ScatterAdd(table, ids, grad, 0);        // table[ids[j]] += grad[j]
+ *  auto parts = Split(batch, {1, 2}, 0);
+ *  auto whole = Concat(parts, 0);
+ */
+
+#include "parallel.h"
+#include "tensor.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define MOU_PREFETCH(ptr) __builtin_prefetch(ptr)
+#else
+#define MOU_PREFETCH(ptr) ((void)(ptr))
+#endif
+
+namespace mou {
+
+namespace tensor {
+
+// rows prefetched ahead of the one being copied
+constexpr size_t kPrefetchRows = 8;
+// bytes prefetched at the start of a row, the hardware follows the rest
+constexpr size_t kPrefetchBytes = 256;
+constexpr size_t kCacheLine = 64;
+
+// (outer, axis, inner) view of `shape` around `axis`
+struct _axis_view {
+    size_t outer;
+    size_t len;
+    size_t inner;
+
+    _axis_view(const Shape& shape, size_t axis)
+        : outer(shape.SizeTo(axis)), len(shape.Size(axis)),
+          inner(shape.SizeFrom(axis + 1)) {}
+};
+
+template <typename DType>
+inline void _prefetch_row(const DType* row, size_t width) {
+    size_t bytes = std::min(width * sizeof(DType), kPrefetchBytes);
+    const char* p = reinterpret_cast<const char*>(row);
+    for (size_t b = 0; b < bytes; b += kCacheLine) MOU_PREFETCH(p + b);
+}
+
+// rows of `width` elements handed to one task
+inline size_t _row_grain(size_t width) {
+    return std::max<size_t>(1, EvalParams().grain
+                               / std::max<size_t>(1, width));
+}
+
+template <typename IType, int DevType, int DevId, typename Allocator>
+void _check_indices(const Tensor<IType, DevType, DevId, Allocator>& indices,
+                    size_t len) {
+    static_assert(std::is_integral_v<IType>, "indices are integers");
+    for (size_t j = 0; j < indices.Size(); ++j) {
+        if (indices[j] < 0 || static_cast<size_t>(indices[j]) >= len) {
+            throw std::out_of_range("index out of range of the axis");
+        }
+    }
+}
+
+/*
+ * dst(o, j, :) = src(o, indices[j], :), dst has the shape of src with
+ * the axis resized to the number of indices
+ */
+template <typename DType, int DevType, int DevId, typename Allocator,
+          typename IType, int IDevType, int IDevId, typename IAllocator>
+void Gather(Tensor<DType, DevType, DevId, Allocator>& dst,
+            const Tensor<DType, DevType, DevId, Allocator>& src,
+            const Tensor<IType, IDevType, IDevId, IAllocator>& indices,
+            size_t axis,
+            parallel::ThreadPool& pool = parallel::ThreadPool::Get()) {
+    _axis_view v(src.Shape_(), axis);
+    size_t k = indices.Size();
+    assert(dst.Shape_() == src.Shape_().With(axis, k));
+    _check_indices(indices, v.len);
+    MOU_PROFILE_SCOPE(profiler::op::copy, dst.Size() * sizeof(DType), 0);
+
+    const DType* in = src.Data();
+    DType* out = dst.Data();
+    const IType* idx = indices.Data();
+    auto row = [&](size_t r) {
+        return in + (r / k * v.len + idx[r % k]) * v.inner;
+    };
+    parallel::ParallelFor(0, v.outer * k, _row_grain(v.inner),
+                          [&](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; ++r) {
+            if (r + kPrefetchRows < end) {
+                _prefetch_row(row(r + kPrefetchRows), v.inner);
+            }
+            std::copy(row(r), row(r) + v.inner, out + r * v.inner);
+        }
+    }, pool);
+}
+
+template <typename DType, int DevType, int DevId, typename Allocator,
+          typename IType, int IDevType, int IDevId, typename IAllocator>
+Tensor<DType, DevType, DevId, Allocator> Gather(
+        const Tensor<DType, DevType, DevId, Allocator>& src,
+        const Tensor<IType, IDevType, IDevId, IAllocator>& indices,
+        size_t axis,
+        parallel::ThreadPool& pool = parallel::ThreadPool::Get()) {
+    Tensor<DType, DevType, DevId, Allocator> dst(
+        src.Shape_().With(axis, indices.Size()));
+    Gather(dst, src, indices, axis, pool);
+    return dst;
+}
+
+/*
+ * dst(o, indices[j], :) += src(o, j, :), repeated indices add up
+ */
+template <typename DType, int DevType, int DevId, typename Allocator,
+          typename IType, int IDevType, int IDevId, typename IAllocator>
+void ScatterAdd(Tensor<DType, DevType, DevId, Allocator>& dst,
+                const Tensor<IType, IDevType, IDevId, IAllocator>& indices,
+                const Tensor<DType, DevType, DevId, Allocator>& src,
+                size_t axis,
+                parallel::ThreadPool& pool = parallel::ThreadPool::Get()) {
+    _axis_view v(dst.Shape_(), axis);
+    size_t k = indices.Size();
+    assert(src.Shape_() == dst.Shape_().With(axis, k));
+    _check_indices(indices, v.len);
+    MOU_PROFILE_SCOPE(profiler::op::eval, src.Size() * sizeof(DType),
+                      src.Size());
+
+    // tasks own disjoint columns of dst, so repeated indices never race
+    const DType* in = src.Data();
+    DType* out = dst.Data();
+    const IType* idx = indices.Data();
+    size_t width = std::min(v.inner, std::max(kCacheLine / sizeof(DType),
+                                              _row_grain(k)));
+    size_t chunks = width == 0 ? 0 : (v.inner + width - 1) / width;
+    parallel::ParallelFor(0, v.outer * chunks, 1,
+                          [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            size_t o = t / chunks, c = t % chunks * width;
+            size_t w = std::min(width, v.inner - c);
+            DType* base = out + o * v.len * v.inner + c;
+            const DType* from = in + o * k * v.inner + c;
+            for (size_t j = 0; j < k; ++j) {
+                if (j + kPrefetchRows < k) {
+                    _prefetch_row(base + idx[j + kPrefetchRows] * v.inner, w);
+                }
+                DType* to = base + idx[j] * v.inner;
+                const DType* row = from + j * v.inner;
+                for (size_t i = 0; i < w; ++i) to[i] += row[i];
+            }
+        }
+    }, pool);
+}
+
+/*
+ * Parts joined along `axis` into dst, parts agree on every other axis
+ */
+template <typename DType, int DevType, int DevId, typename Allocator>
+void Concat(Tensor<DType, DevType, DevId, Allocator>& dst,
+            const std::vector<const Tensor<DType, DevType, DevId,
+                                           Allocator>*>& parts,
+            size_t axis,
+            parallel::ThreadPool& pool = parallel::ThreadPool::Get()) {
+    _axis_view v(dst.Shape_(), axis);
+    std::vector<size_t> first(parts.size() + 1, 0);
+    for (size_t p = 0; p < parts.size(); ++p) {
+        assert(parts[p]->Shape_() ==
+               dst.Shape_().With(axis, parts[p]->Shape_()[axis]));
+        first[p + 1] = first[p] + parts[p]->Shape_()[axis];
+    }
+    assert(first.back() == v.len);
+    MOU_PROFILE_SCOPE(profiler::op::copy, dst.Size() * sizeof(DType), 0);
+
+    DType* out = dst.Data();
+    size_t n = parts.size();
+    parallel::ParallelFor(0, v.outer * n, _row_grain(v.len * v.inner),
+                          [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            size_t o = t / n, p = t % n;
+            size_t block = (first[p + 1] - first[p]) * v.inner;
+            const DType* from = parts[p]->Data() + o * block;
+            std::copy(from, from + block,
+                      out + (o * v.len + first[p]) * v.inner);
+        }
+    }, pool);
+}
+
+template <typename DType, int DevType, int DevId, typename Allocator>
+Tensor<DType, DevType, DevId, Allocator> Concat(
+        const std::vector<Tensor<DType, DevType, DevId, Allocator> >& parts,
+        size_t axis,
+        parallel::ThreadPool& pool = parallel::ThreadPool::Get()) {
+    assert(!parts.empty());
+    std::vector<const Tensor<DType, DevType, DevId, Allocator>*> ptrs;
+    size_t len = 0;
+    for (const auto& t : parts) {
+        ptrs.push_back(&t);
+        len += t.Shape_()[axis];
+    }
+    Tensor<DType, DevType, DevId, Allocator> dst(
+        parts[0].Shape_().With(axis, len));
+    Concat(dst, ptrs, axis, pool);
+    return dst;
+}
+
+/*
+ * Consecutive parts of `sizes` elements along `axis`, the sizes add up
+ * to the length of the axis
+ */
+template <typename DType, int DevType, int DevId, typename Allocator>
+std::vector<Tensor<DType, DevType, DevId, Allocator> > Split(
+        const Tensor<DType, DevType, DevId, Allocator>& src,
+        const std::vector<size_t>& sizes, size_t axis,
+        parallel::ThreadPool& pool = parallel::ThreadPool::Get()) {
+    _axis_view v(src.Shape_(), axis);
+    std::vector<size_t> first(sizes.size() + 1, 0);
+    for (size_t p = 0; p < sizes.size(); ++p) {
+        first[p + 1] = first[p] + sizes[p];
+    }
+    assert(first.back() == v.len);
+
+    std::vector<Tensor<DType, DevType, DevId, Allocator> > parts;
+    parts.reserve(sizes.size());
+    for (size_t s : sizes) parts.emplace_back(src.Shape_().With(axis, s));
+    MOU_PROFILE_SCOPE(profiler::op::copy, src.Size() * sizeof(DType), 0);
+
+    const DType* in = src.Data();
+    size_t n = sizes.size();
+    parallel::ParallelFor(0, v.outer * n, _row_grain(v.len * v.inner),
+                          [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            size_t o = t / n, p = t % n;
+            size_t block = sizes[p] * v.inner;
+            const DType* from = in + (o * v.len + first[p]) * v.inner;
+            std::copy(from, from + block, parts[p].Data() + o * block);
+        }
+    }, pool);
+    return parts;
+}
+
+}; // namespace tensor
+
+}; // namespace mou
+
+#endif // MOU_TENSOR_INDEX_H
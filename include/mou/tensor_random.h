@@ -0,0 +1,161 @@
+#ifndef MOU_TENSOR_RANDOM_H
+#define MOU_TENSOR_RANDOM_H
+
+/*
+ * \brief: counter-based random numbers for expressions and tensors
+ *
+ * Element i of a random expression is computed from (seed, i) alone with
+ * the Philox4x32-10 generator of Salmon et al., "Parallel random numbers:
+ * as easy as 1, 2, 3" (SC 2011). There is no generator state, so a fill
+ * is evaluated by the usual vectorized and parallel loop and gives the
+ * same bits for any number of threads, and any element can be generated
+ * on its own.
+ *
+ * Uniform values use the top 24 (float) or 53 (double) bits of a Philox
+ * output and lie in [lo, hi), up to the rounding of lo + (hi - lo) * u.
+ * Normal values use the Box-Muller transform.
+ *
+ * Example:
+ *  Tensor<float> x{Shape(1024, 1024)};
+ *  RandomNormal(x, 42);
+ *  x = x * 0.1f + Uniform<float>(7, -1, 1);
+ */
+
+#include "expression.h"
+#include "tensor.h"
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+namespace mou {
+
+namespace random {
+
+/*
+ * Philox4x32 with 10 rounds, a pure function of counter and key
+ */
+struct Philox4x32 {
+    using counter = std::array<uint32_t, 4>;
+    using key = std::array<uint32_t, 2>;
+
+    static constexpr uint32_t kMul0 = 0xD2511F53;
+    static constexpr uint32_t kMul1 = 0xCD9E8D57;
+    static constexpr uint32_t kWeyl0 = 0x9E3779B9;
+    static constexpr uint32_t kWeyl1 = 0xBB67AE85;
+    static constexpr int kRounds = 10;
+
+    static inline counter Generate(counter c, key k) {
+        for (int r = 0; r < kRounds; ++r) {
+            if (r != 0) {
+                k[0] += kWeyl0;
+                k[1] += kWeyl1;
+            }
+            uint64_t p0 = uint64_t(kMul0) * c[0];
+            uint64_t p1 = uint64_t(kMul1) * c[2];
+            c = {static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ k[0],
+                 static_cast<uint32_t>(p1),
+                 static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ k[1],
+                 static_cast<uint32_t>(p0)};
+        }
+        return c;
+    }
+
+    // output for element i of the stream of `seed`
+    static inline counter At(uint64_t seed, uint64_t i) {
+        return Generate({static_cast<uint32_t>(i),
+                         static_cast<uint32_t>(i >> 32), 0, 0},
+                        {static_cast<uint32_t>(seed),
+                         static_cast<uint32_t>(seed >> 32)});
+    }
+};
+
+/*
+ * Uniform in [0, 1) from the first one or two words of a Philox output
+ */
+template <typename DType>
+inline DType _unit(uint32_t a, uint32_t b) {
+    if constexpr (std::is_same_v<DType, float>) {
+        return static_cast<float>(a >> 8) * (1.0f / 16777216.0f);
+    } else {
+        uint64_t bits = (uint64_t(a) << 32 | b) >> 11;
+        return static_cast<double>(bits) * (1.0 / 9007199254740992.0);
+    }
+}
+
+template <typename DType>
+struct UniformExp : public expr::Exp<UniformExp<DType> > {
+    static_assert(std::is_floating_point_v<DType>,
+                  "random values are float or double");
+    using type = DType;
+    uint64_t seed;
+    DType lo;
+    DType scale;
+
+    UniformExp(uint64_t seed, DType lo, DType hi)
+        : seed(seed), lo(lo), scale(hi - lo) {}
+
+    inline DType Eval(expr::index_t i) const {
+        auto x = Philox4x32::At(seed, static_cast<uint64_t>(i));
+        return lo + scale * _unit<DType>(x[0], x[1]);
+    }
+};
+
+template <typename DType>
+struct NormalExp : public expr::Exp<NormalExp<DType> > {
+    static_assert(std::is_floating_point_v<DType>,
+                  "random values are float or double");
+    using type = DType;
+    uint64_t seed;
+    DType mean;
+    DType stddev;
+
+    NormalExp(uint64_t seed, DType mean, DType stddev)
+        : seed(seed), mean(mean), stddev(stddev) {}
+
+    inline DType Eval(expr::index_t i) const {
+        constexpr DType kTwoPi = static_cast<DType>(6.28318530717958647692);
+        auto x = Philox4x32::At(seed, static_cast<uint64_t>(i));
+        // 1 - u lies in (0, 1], so the logarithm is finite
+        DType u = 1 - _unit<DType>(x[0], x[1]);
+        DType v = _unit<DType>(x[2], x[3]);
+        return mean + stddev * std::sqrt(-2 * std::log(u))
+            * std::cos(kTwoPi * v);
+    }
+};
+
+/*
+ * Random expression leaves, element i depends on seed and i only
+ */
+template <typename DType>
+inline UniformExp<DType> Uniform(uint64_t seed, DType lo = 0, DType hi = 1) {
+    return UniformExp<DType>(seed, lo, hi);
+}
+
+template <typename DType>
+inline NormalExp<DType> Normal(uint64_t seed, DType mean = 0,
+                               DType stddev = 1) {
+    return NormalExp<DType>(seed, mean, stddev);
+}
+
+/*
+ * Fill a tensor, in parallel for large tensors of a parallel_eval allocator
+ */
+template <typename DType, int DevType, int DevId, typename Allocator>
+inline void RandomUniform(tensor::Tensor<DType, DevType, DevId, Allocator>& t,
+                          uint64_t seed, double lo = 0, double hi = 1) {
+    t = Uniform<DType>(seed, static_cast<DType>(lo), static_cast<DType>(hi));
+}
+
+template <typename DType, int DevType, int DevId, typename Allocator>
+inline void RandomNormal(tensor::Tensor<DType, DevType, DevId, Allocator>& t,
+                         uint64_t seed, double mean = 0, double stddev = 1) {
+    t = Normal<DType>(seed, static_cast<DType>(mean),
+                      static_cast<DType>(stddev));
+}
+
+}; // namespace random
+
+}; // namespace mou
+
+#endif // MOU_TENSOR_RANDOM_H
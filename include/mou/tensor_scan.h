@@ -0,0 +1,260 @@
+#ifndef MOU_TENSOR_SCAN_H
+#define MOU_TENSOR_SCAN_H
+
+/*
+ * \brief: cumulative sum, product and maximum along a tensor axis
+ *
+ * Independent rows of the axis are scanned in parallel. When there are
+ * too few of them to occupy the pool, e.g. a single long series, the axis
+ * is cut into blocks and scanned in two passes: every block is reduced in
+ * parallel, the block totals are scanned serially, then every block is
+ * scanned in parallel starting from the total of the blocks before it.
+ *
+ * Floating-point results of the two-pass scan may differ from a serial
+ * scan by rounding, since the additions are regrouped.
+ *
+ * Example:
+ *  Tensor<float> x{Shape(4, 1000000)};
+ *  auto s = Cumsum(x, 1);  // s(i, j) = x(i, 0) + ... + x(i, j)
+ *  auto m = Cummax(x, 0);
+ */
+
+#include "autotune.h"
+#include "parallel.h"
+#include "tensor.h"
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace mou {
+
+namespace tensor {
+
+// elements per block of the two-pass scan, unless tuned
+constexpr size_t kScanBlock = 1 << 16;
+// independent accumulators of a block reduction, enough for a SIMD register
+constexpr size_t kScanLanes = 8;
+
+/*
+ * Scan Operator
+ * - scan_sum
+ * - scan_prod
+ * - scan_max
+ */
+template <typename DType>
+struct scan_sum {
+    static constexpr DType Identity() { return DType(0); }
+    inline static DType Map(DType a, DType b) { return a + b; }
+};
+
+template <typename DType>
+struct scan_prod {
+    static constexpr DType Identity() { return DType(1); }
+    inline static DType Map(DType a, DType b) { return a * b; }
+};
+
+template <typename DType>
+struct scan_max {
+    static constexpr DType Identity() {
+        return std::numeric_limits<DType>::lowest();
+    }
+    inline static DType Map(DType a, DType b) { return a < b ? b : a; }
+};
+
+/*
+ * Inclusive scan of `len` rows of `width` elements, `stride` elements
+ * apart. The first row is combined with `carry` unless it is null.
+ */
+template <typename OP, typename DType>
+inline void _scan_rows(const DType* in, DType* out, size_t len, size_t stride,
+                       size_t width, const DType* carry) {
+    if (len == 0) return;
+    if (width == 1) {
+        DType c = carry ? OP::Map(*carry, in[0]) : in[0];
+        out[0] = c;
+        for (size_t k = 1; k < len; ++k) {
+            c = OP::Map(c, in[k * stride]);
+            out[k * stride] = c;
+        }
+        return;
+    }
+    for (size_t j = 0; j < width; ++j) {
+        out[j] = carry ? OP::Map(carry[j], in[j]) : in[j];
+    }
+    for (size_t k = 1; k < len; ++k) {
+        const DType* prev = out + (k - 1) * stride;
+        const DType* row = in + k * stride;
+        DType* dst = out + k * stride;
+        for (size_t j = 0; j < width; ++j) dst[j] = OP::Map(prev[j], row[j]);
+    }
+}
+
+/*
+ * total[j] = OP over the `len` rows of `width` elements, `width` apart
+ */
+template <typename OP, typename DType>
+inline void _reduce_rows(const DType* in, size_t len, size_t width,
+                         DType* total) {
+    if (width == 1) {
+        // independent lanes, so that the loop vectorizes
+        DType acc[kScanLanes];
+        for (size_t l = 0; l < kScanLanes; ++l) acc[l] = OP::Identity();
+        size_t k = 0;
+        for (; k + kScanLanes <= len; k += kScanLanes) {
+            for (size_t l = 0; l < kScanLanes; ++l) {
+                acc[l] = OP::Map(acc[l], in[k + l]);
+            }
+        }
+        DType t = OP::Identity();
+        for (size_t l = 0; l < kScanLanes; ++l) t = OP::Map(t, acc[l]);
+        for (; k < len; ++k) t = OP::Map(t, in[k]);
+        *total = t;
+        return;
+    }
+    std::fill(total, total + width, OP::Identity());
+    for (size_t k = 0; k < len; ++k) {
+        const DType* row = in + k * width;
+        for (size_t j = 0; j < width; ++j) total[j] = OP::Map(total[j], row[j]);
+    }
+}
+
+/*
+ * Scan of the middle axis of an (outer, len, inner) row-major array
+ */
+template <typename OP, typename DType>
+void _scan(const DType* in, DType* out, size_t outer, size_t len,
+           size_t inner, size_t block, parallel::ThreadPool& pool) {
+    size_t n = outer * len * inner;
+    if (n == 0) return;
+
+    // columns scanned by one task, so that a task is about p.grain
+    const eval_params& p = EvalParams();
+    size_t width = std::min(inner, std::max(kScanLanes * kScanLanes,
+                                            p.grain / len));
+    size_t chunks = (inner + width - 1) / width;
+    size_t tasks = outer * chunks;
+
+    auto columns = [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            size_t o = t / chunks, j = t % chunks * width;
+            size_t off = o * len * inner + j;
+            _scan_rows<OP>(in + off, out + off, len, inner,
+                           std::min(width, inner - j),
+                           static_cast<const DType*>(nullptr));
+        }
+    };
+    if (n < p.parallel_threshold || pool.NumWorkers() == 0) {
+        columns(0, tasks);
+        return;
+    }
+    if (tasks > pool.NumWorkers()) {
+        size_t grain = std::max<size_t>(1, p.grain / (len * width));
+        parallel::ParallelFor(0, tasks, grain, columns, pool);
+        return;
+    }
+
+    // two passes over blocks of `rows` rows
+    size_t rows = std::max<size_t>(1, block / inner);
+    size_t blocks = (len + rows - 1) / rows;
+    std::vector<DType> totals(blocks * inner);
+    for (size_t o = 0; o < outer; ++o) {
+        const DType* src = in + o * len * inner;
+        DType* dst = out + o * len * inner;
+
+        parallel::ParallelFor(0, blocks - 1, 1, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; ++b) {
+                _reduce_rows<OP>(src + b * rows * inner, rows, inner,
+                                 totals.data() + b * inner);
+            }
+        }, pool);
+        // totals[b] becomes the total of blocks 0 to b
+        for (size_t b = 1; b + 1 < blocks; ++b) {
+            for (size_t j = 0; j < inner; ++j) {
+                totals[b * inner + j] = OP::Map(totals[(b - 1) * inner + j],
+                                                totals[b * inner + j]);
+            }
+        }
+        parallel::ParallelFor(0, blocks, 1, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; ++b) {
+                size_t off = b * rows * inner;
+                _scan_rows<OP>(src + off, dst + off,
+                               std::min(rows, len - b * rows), inner, inner,
+                               b ? totals.data() + (b - 1) * inner
+                                 : static_cast<const DType*>(nullptr));
+            }
+        }, pool);
+    }
+}
+
+inline size_t _tune_scan_block() {
+    auto& pool = parallel::ThreadPool::Get();
+    if (!autotune::Enabled() || pool.NumWorkers() == 0) return kScanBlock;
+
+    const size_t n = 1 << 22;
+    std::vector<float> x(n, 1.f), y(n);
+    return autotune::Choose(
+        "scan.block.t" + std::to_string(pool.NumWorkers()),
+        {1 << 12, 1 << 14, 1 << 16, 1 << 18},
+        [&](size_t block) {
+            return autotune::Time([&] {
+                _scan<scan_sum<float> >(x.data(), y.data(), 1, n, 1, block,
+                                        pool);
+            });
+        });
+}
+
+// tuned on first use
+inline size_t ScanBlock() {
+    static const size_t block = _tune_scan_block();
+    return block;
+}
+
+/*
+ * Inclusive scan of `src` along `axis` with a scan operator
+ */
+template <template <typename> class OP, typename DType, int DevType,
+          int DevId, typename Allocator>
+Tensor<DType, DevType, DevId, Allocator> Scan(
+        const Tensor<DType, DevType, DevId, Allocator>& src, size_t axis,
+        parallel::ThreadPool& pool = parallel::ThreadPool::Get()) {
+    const Shape& shape = src.Shape_();
+    size_t len = shape.Size(axis);
+    size_t inner = shape.SizeFrom(axis + 1);
+    size_t outer = len * inner == 0 ? 0 : src.Size() / (len * inner);
+
+    Tensor<DType, DevType, DevId, Allocator> dst(shape);
+    MOU_PROFILE_SCOPE(profiler::op::eval,
+                      src.Size() * sizeof(DType), src.Size());
+    _scan<OP<DType> >(src.Data(), dst.Data(), outer, len, inner,
+                      ScanBlock(), pool);
+    return dst;
+}
+
+template <typename DType, int DevType, int DevId, typename Allocator>
+inline Tensor<DType, DevType, DevId, Allocator> Cumsum(
+        const Tensor<DType, DevType, DevId, Allocator>& src, size_t axis,
+        parallel::ThreadPool& pool = parallel::ThreadPool::Get()) {
+    return Scan<scan_sum>(src, axis, pool);
+}
+
+template <typename DType, int DevType, int DevId, typename Allocator>
+inline Tensor<DType, DevType, DevId, Allocator> Cumprod(
+        const Tensor<DType, DevType, DevId, Allocator>& src, size_t axis,
+        parallel::ThreadPool& pool = parallel::ThreadPool::Get()) {
+    return Scan<scan_prod>(src, axis, pool);
+}
+
+template <typename DType, int DevType, int DevId, typename Allocator>
+inline Tensor<DType, DevType, DevId, Allocator> Cummax(
+        const Tensor<DType, DevType, DevId, Allocator>& src, size_t axis,
+        parallel::ThreadPool& pool = parallel::ThreadPool::Get()) {
+    return Scan<scan_max>(src, axis, pool);
+}
+
+}; // namespace tensor
+
+}; // namespace mou
+
+#endif // MOU_TENSOR_SCAN_H
@@ -0,0 +1,329 @@
+#ifndef MOU_TENSOR_SORT_H
+#define MOU_TENSOR_SORT_H
+
+/*
+ * \brief: sort, argsort and top-k along a tensor axis
+ *
+ * Rows of the axis are sorted independently and in parallel with a stable
+ * LSD radix sort, one byte per pass. Keys are mapped to unsigned integers
+ * of the same order first: the sign bit of signed integers is flipped,
+ * negative floats have all their bits flipped and positive ones only the
+ * sign bit. Passes where every key has the same byte are skipped. When
+ * there are fewer rows than workers, each row is sorted with all of them,
+ * every worker counting and scattering its own part of the row.
+ *
+ * Floats order as -nan < -inf < ... < -0 < 0 < ... < inf < nan, ties
+ * keep their original order and descending sorts are stable as well.
+ * TopK of few elements keeps a heap of the best k instead of sorting.
+ *
+ * Example:
+ *  Tensor<float> x{Shape(64, 1000)};
+ *  auto s = Sort(x, 1);
+ *  auto i = ArgSort(x, 1, true);         // indices, largest first
+ *  auto [v, j] = TopK(x, 10, 1);         // 10 largest of every row
+ */
+
+#include "parallel.h"
+#include "tensor.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mou {
+
+namespace tensor {
+
+// shorter rows are sorted by comparison
+constexpr size_t kRadixThreshold = 64;
+constexpr size_t kRadixBits = 8;
+constexpr size_t kRadixBuckets = size_t(1) << kRadixBits;
+// TopK keeps a heap when the axis is at least this many times k
+constexpr size_t kTopKHeapRatio = 16;
+
+template <size_t N> struct _uint;
+template <> struct _uint<1> { using type = uint8_t; };
+template <> struct _uint<2> { using type = uint16_t; };
+template <> struct _uint<4> { using type = uint32_t; };
+template <> struct _uint<8> { using type = uint64_t; };
+
+/*
+ * Order-preserving map between DType and unsigned integers
+ */
+template <typename DType>
+struct radix_key {
+    static_assert(std::is_arithmetic_v<DType>, "radix keys are numbers");
+    using type = typename _uint<sizeof(DType)>::type;
+    static constexpr type kSign = type(1) << (sizeof(DType) * 8 - 1);
+
+    static inline type To(DType x) {
+        type b;
+        std::memcpy(&b, &x, sizeof(b));
+        if constexpr (std::is_floating_point_v<DType>) {
+            // all ones for negative numbers
+            type neg = static_cast<type>(0 - (b >> (sizeof(b) * 8 - 1)));
+            return b ^ static_cast<type>(neg | kSign);
+        } else if constexpr (std::is_signed_v<DType>) {
+            return b ^ kSign;
+        } else {
+            return b;
+        }
+    }
+
+    static inline DType From(type k) {
+        if constexpr (std::is_floating_point_v<DType>) {
+            type pos = static_cast<type>(k >> (sizeof(k) * 8 - 1));
+            k ^= static_cast<type>(static_cast<type>(pos - 1) | kSign);
+        } else if constexpr (std::is_signed_v<DType>) {
+            k ^= kSign;
+        }
+        DType x;
+        std::memcpy(&x, &k, sizeof(x));
+        return x;
+    }
+};
+
+/*
+ * Stable sort of key[0, n), and of idx along with it unless it is null.
+ * tmp buffers hold n elements. The row is split into `parts` ranges that
+ * are counted and scattered in parallel.
+ */
+template <typename K>
+void _radix_sort(K* key, expr::index_t* idx, size_t n, K* key_tmp,
+                 expr::index_t* idx_tmp, size_t parts,
+                 parallel::ThreadPool& pool) {
+    if (n < kRadixThreshold) {
+        std::vector<std::pair<K, expr::index_t> > row(n);
+        for (size_t i = 0; i < n; ++i) row[i] = {key[i], idx ? idx[i] : 0};
+        std::stable_sort(row.begin(), row.end(), [](auto& a, auto& b) {
+            return a.first < b.first;
+        });
+        for (size_t i = 0; i < n; ++i) {
+            key[i] = row[i].first;
+            if (idx) idx[i] = row[i].second;
+        }
+        return;
+    }
+
+    parts = std::max<size_t>(1, std::min(parts, n / kRadixThreshold));
+    std::vector<size_t> hist(parts * kRadixBuckets);
+    K* src = key;
+    K* dst = key_tmp;
+    expr::index_t* isrc = idx;
+    expr::index_t* idst = idx_tmp;
+
+    for (size_t shift = 0; shift < sizeof(K) * 8; shift += kRadixBits) {
+        auto digit = [shift](K k) {
+            return static_cast<size_t>(k >> shift) & (kRadixBuckets - 1);
+        };
+        std::fill(hist.begin(), hist.end(), 0);
+        parallel::ParallelFor(0, parts, 1, [&](size_t begin, size_t end) {
+            for (size_t p = begin; p < end; ++p) {
+                auto range = parallel::StaticPartition(0, n, p, parts);
+                size_t* h = hist.data() + p * kRadixBuckets;
+                for (size_t i = range.first; i < range.second; ++i) {
+                    ++h[digit(src[i])];
+                }
+            }
+        }, pool);
+
+        // hist[p][d] becomes the first output position of part p, digit d
+        bool same = false;
+        size_t pos = 0;
+        for (size_t d = 0; d < kRadixBuckets; ++d) {
+            size_t count = 0;
+            for (size_t p = 0; p < parts; ++p) {
+                size_t c = hist[p * kRadixBuckets + d];
+                hist[p * kRadixBuckets + d] = pos + count;
+                count += c;
+            }
+            same = same || count == n;
+            pos += count;
+        }
+        if (same) continue;
+
+        parallel::ParallelFor(0, parts, 1, [&](size_t begin, size_t end) {
+            for (size_t p = begin; p < end; ++p) {
+                auto range = parallel::StaticPartition(0, n, p, parts);
+                size_t* h = hist.data() + p * kRadixBuckets;
+                for (size_t i = range.first; i < range.second; ++i) {
+                    size_t to = h[digit(src[i])]++;
+                    dst[to] = src[i];
+                    if (isrc) idst[to] = isrc[i];
+                }
+            }
+        }, pool);
+        std::swap(src, dst);
+        std::swap(isrc, idst);
+    }
+
+    if (src != key) {
+        std::copy(src, src + n, key);
+        if (idx) std::copy(isrc, isrc + n, idx);
+    }
+}
+
+/*
+ * Sort every row of the axis of `src`, calling `f(row, key, idx)` with
+ * the sorted keys and, if `with_idx`, their positions in the row. The
+ * row r is (r / inner, r % inner) of the (outer, inner) rows.
+ */
+template <typename DType, typename Fn>
+void _sort_rows(const DType* src, const Shape& shape, size_t axis,
+                bool descending, bool with_idx, parallel::ThreadPool& pool,
+                Fn&& f) {
+    using K = typename radix_key<DType>::type;
+    size_t len = shape.Size(axis);
+    size_t inner = shape.SizeFrom(axis + 1);
+    size_t rows = len * inner == 0 ? 0 : shape.Size() / len;
+    if (rows == 0) return;
+
+    // few rows share the workers, many rows are spread over them
+    size_t workers = pool.NumWorkers();
+    size_t parts = rows > workers ? 1 : (workers + 1) / rows;
+    size_t grain = std::max<size_t>(1, kEvalGrain / len);
+
+    parallel::ParallelFor(0, rows, grain, [&](size_t begin, size_t end) {
+        std::vector<K> key(len), key_tmp(len);
+        std::vector<expr::index_t> idx(with_idx ? len : 0);
+        std::vector<expr::index_t> idx_tmp(idx.size());
+        K flip = descending ? static_cast<K>(~K(0)) : K(0);
+
+        for (size_t r = begin; r < end; ++r) {
+            const DType* row = src + r / inner * len * inner + r % inner;
+            for (size_t k = 0; k < len; ++k) {
+                key[k] = radix_key<DType>::To(row[k * inner]) ^ flip;
+            }
+            for (size_t k = 0; k < idx.size(); ++k) idx[k] = k;
+            _radix_sort(key.data(), with_idx ? idx.data() : nullptr, len,
+                        key_tmp.data(), idx_tmp.data(), parts, pool);
+            for (size_t k = 0; k < len; ++k) key[k] ^= flip;
+            f(r, key.data(), idx.data());
+        }
+    }, pool);
+}
+
+/*
+ * Values of `src` in order along `axis`
+ */
+template <typename DType, int DevType, int DevId, typename Allocator>
+Tensor<DType, DevType, DevId, Allocator> Sort(
+        const Tensor<DType, DevType, DevId, Allocator>& src, size_t axis,
+        bool descending = false,
+        parallel::ThreadPool& pool = parallel::ThreadPool::Get()) {
+    const Shape& shape = src.Shape_();
+    size_t len = shape.Size(axis), inner = shape.SizeFrom(axis + 1);
+    Tensor<DType, DevType, DevId, Allocator> dst(shape);
+    MOU_PROFILE_SCOPE(profiler::op::eval,
+                      src.Size() * sizeof(DType), src.Size());
+    DType* out = dst.Data();
+    _sort_rows(src.Data(), shape, axis, descending, false, pool,
+               [&](size_t r, const auto* key, const expr::index_t*) {
+        DType* row = out + r / inner * len * inner + r % inner;
+        for (size_t k = 0; k < len; ++k) {
+            row[k * inner] = radix_key<DType>::From(key[k]);
+        }
+    });
+    return dst;
+}
+
+/*
+ * Positions along `axis` that sort `src`, equal values in their order
+ */
+template <typename DType, int DevType, int DevId, typename Allocator>
+Tensor<expr::index_t> ArgSort(
+        const Tensor<DType, DevType, DevId, Allocator>& src, size_t axis,
+        bool descending = false,
+        parallel::ThreadPool& pool = parallel::ThreadPool::Get()) {
+    const Shape& shape = src.Shape_();
+    size_t len = shape.Size(axis), inner = shape.SizeFrom(axis + 1);
+    Tensor<expr::index_t> dst(shape);
+    MOU_PROFILE_SCOPE(profiler::op::eval,
+                      src.Size() * sizeof(DType), src.Size());
+    expr::index_t* out = dst.Data();
+    _sort_rows(src.Data(), shape, axis, descending, true, pool,
+               [&](size_t r, const auto*, const expr::index_t* idx) {
+        expr::index_t* row = out + r / inner * len * inner + r % inner;
+        for (size_t k = 0; k < len; ++k) row[k * inner] = idx[k];
+    });
+    return dst;
+}
+
+/*
+ * The k largest values along `axis`, largest first, and their positions.
+ * Equal values keep their order.
+ */
+template <typename DType, int DevType, int DevId, typename Allocator>
+std::pair<Tensor<DType, DevType, DevId, Allocator>, Tensor<expr::index_t> >
+TopK(const Tensor<DType, DevType, DevId, Allocator>& src, size_t k,
+     size_t axis, parallel::ThreadPool& pool = parallel::ThreadPool::Get()) {
+    using K = typename radix_key<DType>::type;
+    const Shape& shape = src.Shape_();
+    size_t len = shape.Size(axis), inner = shape.SizeFrom(axis + 1);
+    if (k > len) throw std::out_of_range("TopK: k exceeds the axis");
+
+    Shape top = shape.With(axis, k);
+    Tensor<DType, DevType, DevId, Allocator> values(top);
+    Tensor<expr::index_t> indices(top);
+    MOU_PROFILE_SCOPE(profiler::op::eval,
+                      src.Size() * sizeof(DType), src.Size());
+    DType* vout = values.Data();
+    expr::index_t* iout = indices.Data();
+    auto emit = [&](size_t r, size_t j, K key, expr::index_t i) {
+        size_t off = r / inner * k * inner + r % inner + j * inner;
+        vout[off] = radix_key<DType>::From(key);
+        iout[off] = i;
+    };
+
+    if (k * kTopKHeapRatio > len) {
+        _sort_rows(src.Data(), shape, axis, true, true, pool,
+                   [&](size_t r, const K* key, const expr::index_t* idx) {
+            for (size_t j = 0; j < k; ++j) emit(r, j, key[j], idx[j]);
+        });
+        return {std::move(values), std::move(indices)};
+    }
+
+    size_t rows = len * inner == 0 ? 0 : shape.Size() / len;
+    size_t grain = std::max<size_t>(1, kEvalGrain / len);
+    const DType* in = src.Data();
+    parallel::ParallelFor(0, rows, grain, [&](size_t begin, size_t end) {
+        using entry = std::pair<K, expr::index_t>;
+        // a before b in the result, so the heap top is the worst kept
+        auto better = [](const entry& a, const entry& b) {
+            return a.first > b.first ||
+                (a.first == b.first && a.second < b.second);
+        };
+        std::vector<entry> heap;
+        heap.reserve(k);
+        for (size_t r = begin; r < end; ++r) {
+            const DType* row = in + r / inner * len * inner + r % inner;
+            heap.clear();
+            for (size_t i = 0; i < len && k != 0; ++i) {
+                entry e{radix_key<DType>::To(row[i * inner]),
+                        static_cast<expr::index_t>(i)};
+                if (heap.size() < k) {
+                    heap.push_back(e);
+                    std::push_heap(heap.begin(), heap.end(), better);
+                } else if (better(e, heap.front())) {
+                    std::pop_heap(heap.begin(), heap.end(), better);
+                    heap.back() = e;
+                    std::push_heap(heap.begin(), heap.end(), better);
+                }
+            }
+            std::sort_heap(heap.begin(), heap.end(), better);
+            for (size_t j = 0; j < heap.size(); ++j) {
+                emit(r, j, heap[j].first, heap[j].second);
+            }
+        }
+    }, pool);
+    return {std::move(values), std::move(indices)};
+}
+
+}; // namespace tensor
+
+}; // namespace mou
+
+#endif // MOU_TENSOR_SORT_H
@@ -0,0 +1,42 @@
+#include "../include/mou/tensor.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+using namespace mou;
+using namespace mou::tensor;
+
+template <typename Fn>
+double seconds(Fn&& f, int reps) {
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; ++r) f();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+    return d.count() / reps;
+}
+
+int main() {
+    const size_t n = (size_t(1) << 31) + 4096;
+    Tensor<int8_t> x{Shape(n)};
+    x = 0;
+
+    double t = seconds([&] { x = x * 2 + 1; }, 3);
+    printf("eval %zu int8: %.3f s, %.2f GB/s\n", n, t, 2.0 * n / t / 1e9);
+
+    // the same amount of work on the 32-bit fast path, ending below 2^31,
+    // and on the 64-bit path, ending past it
+    const expr::index_t m = expr::index_t(1) << 28;
+    const expr::index_t split = expr::index_t(1) << 31;
+    const expr::index_t last = static_cast<expr::index_t>(n);
+    expr::Vec<int8_t> v(x.Data(), n);
+    auto e = v * 2 + 1;
+    double t32 = seconds([&] {
+        expr::EvalRange(x.Data(), e, split - m, split);
+    }, 5);
+    double t64 = seconds([&] {
+        expr::EvalRange(x.Data(), e, last - m, last);
+    }, 5);
+    printf("%lld elements, 32-bit index: %.3f s, 64-bit index: %.3f s\n",
+           static_cast<long long>(m), t32, t64);
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include "../include/mou/async.h"
+#include "../include/mou/logger.h"
+#include "../include/mou/tensor.h"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+using namespace mou;
+using namespace mou::async;
+using namespace mou::tensor;
+
+void test_Region() {
+    int buf[8];
+    Region a{buf, 4 * sizeof(int)}, b{buf + 4, 4 * sizeof(int)};
+    Region c{buf + 3, 2 * sizeof(int)}, empty{buf, 0};
+    CHECK(!a.Overlaps(b));
+    CHECK(a.Overlaps(c));
+    CHECK(b.Overlaps(c));
+    CHECK(!a.Overlaps(empty));
+}
+
+void test_EvalAsync() {
+    Tensor<float> a(Shape(1000)), b(Shape(1000)), c(Shape(1000)),
+                  d(Shape(1000));
+    a = 1;
+
+    // a chain of stages, each waits for the one writing its input
+    EvalAsync(b, a * 2);
+    EvalAsync(c, b + 1);
+    auto last = EvalAsync(d, c * b);
+    last.wait();
+    CHECK_EQ(b[999], 2.f);
+    CHECK_EQ(c[0], 3.f);
+    CHECK_EQ(d[500], 6.f);
+
+    // write after read, b must not change before c read it
+    EvalAsync(c, b * 10);
+    EvalAsync(b, 7);
+    Executor::Get().Wait();
+    CHECK_EQ(c[1], 20.f);
+    CHECK_EQ(b[1], 7.f);
+
+    // scalars are copied into the expression
+    for (int k = 0; k < 4; ++k) {
+        EvalAsync(a, a + k);
+    }
+    Executor::Get().Wait();
+    CHECK_EQ(a[0], 7.f);
+
+    // temporary nodes outlive the full expression
+    auto f = EvalAsync(d, (a + 1) * (b - 2));
+    f.wait();
+    CHECK_EQ(d[999], 40.f);
+}
+
+void test_Independent() {
+    parallel::ThreadPool pool(2);
+    Executor ex(pool);
+    std::atomic<int> running{0};
+    std::atomic<int> overlap{0};
+    int x = 0, y = 0;
+    auto body = [&] {
+        if (++running == 2) ++overlap;
+        auto until = std::chrono::steady_clock::now()
+            + std::chrono::milliseconds(200);
+        while (running < 2 && std::chrono::steady_clock::now() < until) {
+            std::this_thread::yield();
+        }
+        --running;
+    };
+    auto f1 = ex.Submit({}, {Region{&x, sizeof(x)}}, body);
+    auto f2 = ex.Submit({}, {Region{&y, sizeof(y)}}, body);
+    f1.wait();
+    f2.wait();
+    CHECK_EQ(overlap, 1);
+}
+
+void test_Error() {
+    Executor ex;
+    int x = 0;
+    auto f1 = ex.Submit({}, {Region{&x, sizeof(x)}}, [] {
+        throw std::runtime_error("stage");
+    });
+    auto f2 = ex.Submit({Region{&x, sizeof(x)}}, {}, [] {});
+
+    bool thrown = false;
+    try {
+        f1.get();
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    f2.get();
+}
+
+// futures are ready once Wait() returns
+void test_Wait() {
+    parallel::ThreadPool pool(1);
+    Executor ex(pool);
+    int x = 0;
+    bool ready = true;
+    for (int k = 0; k < 200; ++k) {
+        auto f = ex.Submit({}, {Region{&x, sizeof(x)}}, [&x] { ++x; });
+        ex.Wait();
+        ready = ready && f.wait_for(std::chrono::seconds(0))
+            == std::future_status::ready;
+    }
+    CHECK(ready);
+    CHECK_EQ(x, 200);
+}
+
+int main() {
+    test_Region();
+    test_EvalAsync();
+    test_Independent();
+    test_Error();
+    test_Wait();
+
+    return 0;
+}
@@ -0,0 +1,221 @@
+#include "../include/mou/autodiff.h"
+#include "../include/mou/logger.h"
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+
+using namespace mou;
+using namespace mou::tensor;
+using namespace mou::expr;
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+// heap allocations of the whole program, to check the arena
+static std::atomic<size_t> allocations{0};
+static std::atomic<size_t> aligned_allocations{0};
+
+void* operator new(size_t n) {
+    ++allocations;
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+// the arena allocates its blocks with the aligned overloads
+void* operator new(size_t n, std::align_val_t align) {
+    ++allocations;
+    ++aligned_allocations;
+    size_t a = static_cast<size_t>(align);
+    if (void* p = std::aligned_alloc(a, (n + a - 1) / a * a)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void test_Arena() {
+    size_t before = aligned_allocations.load();
+    autodiff::Arena arena(256);
+    float* a = arena.Allocate<float>(10);
+    double* b = arena.Allocate<double>(100);
+    CHECK_EQ(reinterpret_cast<uintptr_t>(a) % kSimdAlignment, 0u);
+    CHECK_EQ(reinterpret_cast<uintptr_t>(b) % kSimdAlignment, 0u);
+    CHECK_LE(reinterpret_cast<char*>(a) + 10 * sizeof(float),
+             reinterpret_cast<char*>(b));
+
+    // blocks are merged on reset, then the same requests fit in place
+    CHECK_LT(256u, arena.Capacity());
+    arena.Reset();
+    size_t capacity = arena.Capacity();
+    float* a2 = arena.Allocate<float>(10);
+    arena.Allocate<double>(100);
+    CHECK_EQ(arena.Capacity(), capacity);
+    arena.Reset();
+    CHECK_EQ(arena.Allocate<float>(10), a2);
+    // two blocks, then the merged one
+    CHECK_EQ(aligned_allocations.load(), before + 3);
+}
+
+void test_Elementwise() {
+    Tensor<double> W{0.5, -1.0, 2.0}, dW{Shape(3)};
+    Tensor<double> X{1.0, 2.0, 3.0}, B{0.1, 0.2, 0.3};
+    dW = 0.0;
+
+    autodiff::Tape tape;
+    auto w = tape.Param(W, dW);
+    auto h = tape.Compute(F<math::tanh>(F<axpy>(w, X, B)));
+    CHECK(h.Shape_() == Shape(3));
+    auto loss = tape.Sum(h * h / 2.0 + w);
+    tape.Backward(loss);
+
+    double expected_loss = 0;
+    for (size_t i = 0; i < 3; ++i) {
+        double t = std::tanh(W[i] * X[i] + B[i]);
+        expected_loss += t * t / 2 + W[i];
+        // d/dw of tanh(wx + b)^2 / 2 + w
+        double grad = t * (1 - t * t) * X[i] + 1;
+        CHECK_LT(std::abs(dW[i] - grad), 1e-12);
+        CHECK_LT(std::abs(h.Value()[i] - t), 1e-12);
+    }
+    CHECK_LT(std::abs(loss.Value()[0] - expected_loss), 1e-12);
+}
+
+// gradients of every op against central differences
+template <typename Build>
+void check_numeric(Tensor<double>& X, Build&& build) {
+    Tensor<double> dX{X.Shape_()};
+    dX = 0.0;
+    autodiff::Tape tape;
+    auto x = tape.Param(X, dX);
+    tape.Backward(tape.Sum(build(tape, x)));
+
+    const double h = 1e-6;
+    for (size_t i = 0; i < X.Size(); ++i) {
+        double x0 = X[i];
+        Tensor<double> unused{X.Shape_()};
+        autodiff::Tape t;
+        X[i] = x0 + h;
+        double up = t.Sum(build(t, t.Param(X, unused))).Value()[0];
+        X[i] = x0 - h;
+        double down = t.Sum(build(t, t.Param(X, unused))).Value()[0];
+        X[i] = x0;
+        CHECK_LT(std::abs(dX[i] - (up - down) / (2 * h)), 1e-5);
+    }
+}
+
+void test_Ops() {
+    Tensor<double> X{0.3, 1.2, -0.7, 2.5};
+    Tensor<double> P{0.9, 1.5, 2.0, 0.4};
+    check_numeric(X, [&](autodiff::Tape&, auto x) {
+        return x * x - x / (P + 1.0) + F<negation>(x) * 3.0;
+    });
+    check_numeric(X, [&](autodiff::Tape&, auto x) {
+        return P / (x * x + 1.0) + F<axpy>(x, P, x);
+    });
+    check_numeric(X, [&](autodiff::Tape&, auto x) {
+        return F<math::exp>(x) + F<math::sigmoid>(x) + F<math::erf>(x)
+            + F<math::fast::tanh>(x);
+    });
+    check_numeric(X, [&](autodiff::Tape&, auto x) {
+        return F<math::log>(x * x + 1.0) + F<math::sqrt>(x * x + 2.0);
+    });
+    // relu through Where, the mask has no gradient
+    check_numeric(X, [&](autodiff::Tape& tape, auto x) {
+        auto r = tape.Compute(Where(x > 0.0, x, 0.0));
+        return r * P + x * (x > 0.0);
+    });
+}
+
+// a Var used by two later records gets the sum of both gradients
+void test_Chain() {
+    Tensor<float> A{1.f, 2.f}, dA{Shape(2)};
+    dA = 0.f;
+    autodiff::Tape tape;
+    auto a = tape.Param(A, dA);
+    auto b = tape.Compute(a * 3.f);
+    auto c = tape.Compute(b * b);
+    auto d = tape.Sum(c + b);
+    tape.Backward(d);
+    // d = sum(9 a^2 + 3 a), dd/da = 18 a + 3
+    CHECK_EQ(dA[0], 21.f);
+    CHECK_EQ(dA[1], 39.f);
+    CHECK_EQ(b.Grad()[1], 13.f);
+}
+
+// fit y = 3 x + 1 by gradient descent, without heap allocations once
+// the arena has grown
+void test_Training() {
+    const size_t n = 256;
+    Tensor<float> X{Shape(n)}, Y{Shape(n)};
+    Tensor<float> W{Shape(n)}, B{Shape(n)}, dW{Shape(n)}, dB{Shape(n)};
+    for (size_t i = 0; i < n; ++i) X[i] = static_cast<float>(i % 7) / 7;
+    Y = X * 3.f + 1.f;
+    W = 0.f;
+    B = 0.f;
+
+    autodiff::Tape tape;
+    size_t warm = 0, capacity = 0;
+    float loss = 0;
+    for (int step = 0; step < 500; ++step) {
+        if (step == 2) {
+            warm = allocations.load();
+            capacity = tape.Arena_().Capacity();
+        }
+        dW = 0.f;
+        dB = 0.f;
+        auto w = tape.Param(W, dW);
+        auto b = tape.Param(B, dB);
+        auto err = tape.Compute(F<axpy>(w, X, b) - Y);
+        auto l = tape.Sum(err * err);
+        tape.Backward(l);
+        loss = l.Data()[0];
+        W = W - dW * 0.2f;
+        B = B - dB * 0.2f;
+        tape.Reset();
+    }
+    CHECK_EQ(allocations.load(), warm);
+    CHECK_EQ(tape.Arena_().Capacity(), capacity);
+    CHECK_LT(loss, 1e-4f);
+}
+
+// large records run on the pool
+void test_Large() {
+    const size_t n = 1 << 18;
+    Tensor<float> X{Shape(n)}, dX{Shape(n)};
+    X = 2.f;
+    dX = 0.f;
+    autodiff::Tape tape;
+    auto x = tape.Param(X, dX);
+    auto y = tape.Compute(x * x * x);
+    auto s = tape.Sum(y);
+    tape.Backward(s);
+    CHECK_EQ(s.Data()[0], 8.f * n);
+    bool same = true;
+    for (size_t i = 0; i < n; ++i) same = same && dX[i] == 12.f;
+    CHECK(same);
+}
+
+int main() {
+    test_Arena();
+    test_Elementwise();
+    test_Ops();
+    test_Chain();
+    test_Training();
+    test_Large();
+    return 0;
+}
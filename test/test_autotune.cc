@@ -0,0 +1,96 @@
+#include "../include/mou/autotune.h"
+#include "../include/mou/logger.h"
+#include "../include/mou/tensor.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+using namespace mou;
+
+const std::string path = "/tmp/mou_test_autotune/cache";
+
+void test_Choose() {
+    std::remove(path.c_str());
+    int timed = 0;
+    // cost is lowest at 300
+    auto cost = [&](size_t c) {
+        ++timed;
+        return c > 300 ? double(c - 300) : double(300 - c);
+    };
+    {
+        autotune::Cache cache(path);
+        CHECK_EQ(autotune::Choose("a", {100, 200, 400, 800}, cost, cache),
+                 size_t(200));
+        CHECK_EQ(timed, 4);
+        CHECK_EQ(autotune::Choose("a", {100, 200}, cost, cache),
+                 size_t(200));
+        CHECK_EQ(timed, 4);
+
+        // parallel wins from 64 on
+        auto slow = [](size_t n) { return double(n); };
+        auto fast = [](size_t n) { return 40 + n / 4.0; };
+        CHECK_EQ(autotune::Crossover("x", {16, 32, 64, 128}, slow, fast,
+                                     cache), size_t(64));
+        CHECK_EQ(autotune::Crossover("y", {16, 32}, slow, fast, cache),
+                 size_t(33));
+    }
+
+    // a later process reads the cache instead of timing
+    autotune::Cache cache(path);
+    size_t value = 0;
+    CHECK(cache.Lookup("a", value) && value == 200);
+    CHECK(cache.Lookup("x", value) && value == 64);
+    CHECK(!cache.Lookup("b", value));
+    CHECK_EQ(autotune::Choose("a", {100, 200}, cost, cache), size_t(200));
+    CHECK_EQ(timed, 4);
+
+    // cached values outside the new candidates are tuned again
+    CHECK_EQ(autotune::Choose("a", {100}, cost, cache), size_t(100));
+    CHECK_EQ(timed, 5);
+    CHECK(cache.Lookup("a", value) && value == 100);
+    int measured = 0;
+    auto slow = [&](size_t n) { ++measured; return double(n); };
+    auto fast = [](size_t n) { return 40 + n / 4.0; };
+    CHECK_EQ(autotune::Crossover("x", {16, 32, 64}, slow, fast, cache),
+             size_t(64));
+    CHECK_EQ(measured, 0);
+    CHECK_EQ(autotune::Crossover("x", {16, 32}, slow, fast, cache),
+             size_t(33));
+    CHECK_EQ(measured, 2);
+
+    CHECK(autotune::Time([] {}) >= 0);
+}
+
+void test_EvalParams() {
+    std::remove(path.c_str());
+    setenv("MOU_AUTOTUNE_CACHE", path.c_str(), 1);
+    setenv("MOU_AUTOTUNE", "1", 1);
+    CHECK(autotune::Enabled());
+    CHECK_EQ(autotune::Cache::Get().Path(), path);
+
+    const tensor::eval_params& p = tensor::EvalParams();
+    CHECK(p.grain >= 1 << 12 && p.grain <= 1 << 17);
+    CHECK(p.parallel_threshold >= 1 << 12);
+
+    if (parallel::ThreadPool::Get().NumWorkers() != 0) {
+        std::ifstream in(path);
+        std::string text((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+        CHECK(text.find("eval.grain.t") != std::string::npos);
+        CHECK(text.find("eval.parallel_threshold.t") != std::string::npos);
+    }
+
+    // tensors evaluate with the tuned parameters
+    tensor::Tensor<float> t{tensor::Shape(1 << 18)};
+    t = 1;
+    t = t * 3;
+    CHECK_EQ(t[(1 << 18) - 1], 3.f);
+}
+
+int main() {
+    test_Choose();
+    test_EvalParams();
+
+    return 0;
+}
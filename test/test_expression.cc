@@ -53,6 +53,55 @@ int main() {
                i, D.dptr[i], A.dptr[i], B.dptr[i], C.dptr[i]);
     }
 
+    // test for n-ary lambda expression
+    DType k = 10;
+    D = F([k](auto a, auto b, auto c, auto d) { return a * b + c * d + k; },
+          A, B, C, B) - A;
+
+    for (int i = 0; i < n; ++i) {
+        printf("%d:%d == %d * %d + %d * %d + %d - %d\n",
+               i, D.dptr[i], A.dptr[i], B.dptr[i], C.dptr[i],
+               B.dptr[i], k, A.dptr[i]);
+    }
+
+    // result type follows the callable
+    double se[n];
+    Vec<double> E(se, n);
+    auto half = F([](int a) { return a / 2.0; }, A);
+    static_assert(std::is_same_v<decltype(half)::type, double>);
+    E = half;
+
+    for (int i = 0; i < n; ++i) {
+        printf("%d:%g == %d / 2.0\n", i, E.dptr[i], A.dptr[i]);
+    }
+
+    // test for comparison and select
+    D = Where(A > 1 && !(B == 4), C, 0);
+
+    for (int i = 0; i < n; ++i) {
+        printf("%d:%d == %d > 1 && !(%d == 4) ? %d : 0\n",
+               i, D.dptr[i], A.dptr[i], B.dptr[i], C.dptr[i]);
+    }
+
+    bool sm[n];
+    Vec<bool> M(sm, n);
+    M = A <= 1 || 3 < B;
+    static_assert(std::is_same_v<decltype(A < B)::type, bool>);
+
+    for (int i = 0; i < n; ++i) {
+        printf("%d:%d == %d <= 1 || 3 < %d\n",
+               i, M.dptr[i], A.dptr[i], B.dptr[i]);
+    }
+
+    // test for masked assign, unselected elements are kept
+    D = 7;
+    Masked(D, M) = A * 10;
+
+    for (int i = 0; i < n; ++i) {
+        printf("%d:%d == %d ? %d * 10 : 7\n",
+               i, D.dptr[i], M.dptr[i], A.dptr[i]);
+    }
+
     // test for scalar assign
     D = -1;
 
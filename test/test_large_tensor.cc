@@ -0,0 +1,41 @@
+#include "../include/mou/logger.h"
+#include "../include/mou/tensor.h"
+#include <cstdint>
+#include <iostream>
+
+using namespace mou;
+using namespace mou::tensor;
+
+// int8 keeps the tensor at about 2 GB
+void test_LargeTensor() {
+    const size_t n = (size_t(1) << 31) + 4096;
+    Tensor<int8_t> x(Shape(2, n / 2));
+    CHECK_EQ(x.Size(), n);
+
+    x = 0;
+    x[n - 1] = 5;
+    x[size_t(1) << 31] = 3;
+    x = x * 2 + 1;
+    CHECK_EQ(x[0], 1);
+    CHECK_EQ(x[(size_t(1) << 31) - 1], 1);
+    CHECK_EQ(x[size_t(1) << 31], 7);
+    CHECK_EQ(x[n - 1], 11);
+
+    // the second half of the tensor lies beyond 2^31 elements
+    CHECK_EQ(x.Shape_().Stride(0), n / 2);
+}
+
+void test_Index() {
+    static_assert(sizeof(expr::index_t) >= 8, "64-bit indices");
+    int8_t buf[4] = {1, 2, 3, 4};
+    expr::Vec<int8_t> v(buf, 4);
+    v = v + 1;
+    CHECK_EQ(buf[3], 5);
+}
+
+int main() {
+    test_Index();
+    test_LargeTensor();
+
+    return 0;
+}
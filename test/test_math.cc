@@ -0,0 +1,186 @@
+#include "../include/mou/logger.h"
+#include "../include/mou/math.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace mou;
+using namespace mou::expr;
+
+// distance from y to the exact value in units of the last place of T
+template <typename T>
+double ulp_error(T y, long double exact) {
+    if (std::isnan(exact)) return std::isnan(y) ? 0 : 1e30;
+    if (std::isinf(exact)) return y == exact ? 0 : 1e30;
+    int e = std::ilogb(exact == 0 ? std::numeric_limits<T>::min() : exact);
+    e = std::max(e, std::numeric_limits<T>::min_exponent - 1);
+    long double ulp = std::ldexp(1.0L, e - std::numeric_limits<T>::digits + 1);
+    return static_cast<double>(std::fabs(y - exact) / ulp);
+}
+
+template <typename T>
+std::vector<T> uniform(T lo, T hi, size_t n) {
+    std::mt19937_64 gen(42);
+    std::uniform_real_distribution<T> dist(lo, hi);
+    std::vector<T> v(n);
+    for (auto& x : v) x = dist(gen);
+    return v;
+}
+
+// positive finite numbers of every exponent
+template <typename T>
+std::vector<T> positive(size_t n) {
+    std::mt19937_64 gen(7);
+    std::vector<T> v;
+    while (v.size() < n) {
+        T x;
+        uint64_t b = gen();
+        std::memcpy(&x, &b, sizeof(x));
+        x = std::fabs(x);
+        if (std::isfinite(x)) v.push_back(x);
+    }
+    return v;
+}
+
+template <template <typename> class OP, typename T, typename Ref>
+double max_ulp(const char* name, std::vector<T> in, Ref ref) {
+    std::vector<T> out(in.size());
+    Vec<T> x(in.data(), in.size()), y(out.data(), out.size());
+    y = F<OP>(x);
+    double worst = 0;
+    T at = 0;
+    for (size_t i = 0; i < in.size(); ++i) {
+        double err = ulp_error(out[i], ref(static_cast<long double>(in[i])));
+        if (err > worst) {
+            worst = err;
+            at = in[i];
+        }
+    }
+    printf("%-8s %-6s %10.2f ulp at %.9g\n", name,
+           sizeof(T) == 4 ? "float" : "double", worst, (double)at);
+    return worst;
+}
+
+const size_t n = 1 << 20;
+
+long double sigmoid(long double x) {
+    return 1 / (1 + std::exp(-x));
+}
+
+template <typename T>
+void test_accurate() {
+    using L = long double;
+    auto exp_ = [](L x) { return std::exp(x); };
+    auto log_ = [](L x) { return std::log(x); };
+    auto tanh_ = [](L x) { return std::tanh(x); };
+    auto sqrt_ = [](L x) { return std::sqrt(x); };
+    auto erf_ = [](L x) { return std::erf(x); };
+    T lo = std::numeric_limits<T>::min_exponent * T(0.7);
+    T hi = std::numeric_limits<T>::max_exponent * T(0.69);
+
+    CHECK_LE(max_ulp<math::exp>("exp", uniform<T>(lo, hi, n), exp_), 2);
+    CHECK_LE(max_ulp<math::exp>("exp", uniform<T>(-1, 1, n), exp_), 2);
+    CHECK_LE(max_ulp<math::log>("log", positive<T>(n), log_), 2);
+    CHECK_LE(max_ulp<math::log>("log", uniform<T>(0.5, 2, n), log_), 2);
+    CHECK_LE(max_ulp<math::tanh>("tanh", uniform<T>(-25, 25, n), tanh_), 3);
+    CHECK_LE(max_ulp<math::tanh>("tanh", uniform<T>(-1, 1, n), tanh_), 3);
+    CHECK_LE(max_ulp<math::sigmoid>("sigmoid", uniform<T>(-hi, hi, n),
+                                    sigmoid), 3);
+    CHECK_LE(max_ulp<math::sqrt>("sqrt", positive<T>(n), sqrt_), 1);
+    CHECK_LE(max_ulp<math::erf>("erf", uniform<T>(-7, 7, n), erf_), 3);
+    CHECK_LE(max_ulp<math::erf>("erf", uniform<T>(-1, 1, n), erf_), 3);
+}
+
+// bounds of exp, log, tanh, sigmoid, sqrt and erf
+template <typename T>
+void test_fast(const double (&bound)[6]) {
+    using L = long double;
+    auto exp_ = [](L x) { return std::exp(x); };
+    auto log_ = [](L x) { return std::log(x); };
+    auto tanh_ = [](L x) { return std::tanh(x); };
+    auto sqrt_ = [](L x) { return std::sqrt(x); };
+    auto erf_ = [](L x) { return std::erf(x); };
+
+    CHECK_LE(max_ulp<math::fast::exp>("exp", uniform<T>(-80, 80, n), exp_),
+             bound[0]);
+    CHECK_LE(max_ulp<math::fast::log>("log", positive<T>(n), log_),
+             bound[1]);
+    CHECK_LE(max_ulp<math::fast::tanh>("tanh", uniform<T>(-25, 25, n), tanh_),
+             bound[2]);
+    CHECK_LE(max_ulp<math::fast::sigmoid>("sigmoid", uniform<T>(-80, 80, n),
+                                          sigmoid), bound[3]);
+    CHECK_LE(max_ulp<math::fast::sqrt>("sqrt", positive<T>(n), sqrt_),
+             bound[4]);
+    CHECK_LE(max_ulp<math::fast::erf>("erf", uniform<T>(-7, 7, n), erf_),
+             bound[5]);
+}
+
+template <typename T>
+void test_special() {
+    const T inf = std::numeric_limits<T>::infinity();
+    const T nan = std::numeric_limits<T>::quiet_NaN();
+    T in[] = {0, -0.0, inf, -inf, nan, -1};
+    T out[6];
+    Vec<T> x(in, 6), y(out, 6);
+
+    y = F<math::exp>(x);
+    CHECK_EQ(out[0], 1);
+    CHECK_EQ(out[2], inf);
+    CHECK_EQ(out[3], 0);
+    CHECK(std::isnan(out[4]));
+
+    y = F<math::log>(x);
+    CHECK_EQ(out[0], -inf);
+    CHECK_EQ(out[2], inf);
+    CHECK(std::isnan(out[3]));
+    CHECK(std::isnan(out[5]));
+
+    y = F<math::sqrt>(x);
+    CHECK_EQ(out[0], 0);
+    CHECK(std::signbit(out[1]));
+    CHECK_EQ(out[2], inf);
+    CHECK(std::isnan(out[5]));
+
+    y = F<math::tanh>(x);
+    CHECK_EQ(out[2], 1);
+    CHECK_EQ(out[3], -1);
+    CHECK(std::signbit(out[1]));
+
+    y = F<math::sigmoid>(x);
+    CHECK_EQ(out[0], T(0.5));
+    CHECK_EQ(out[2], 1);
+    CHECK_EQ(out[3], 0);
+
+    y = F<math::erf>(x);
+    CHECK_EQ(out[2], 1);
+    CHECK_EQ(out[3], -1);
+    CHECK(std::isnan(out[4]));
+}
+
+void test_expression() {
+    int in[] = {1, 4, 9};
+    double out[3];
+    Vec<int> x(in, 3);
+    Vec<double> y(out, 3);
+    // integers are computed in double
+    y = F<math::sqrt>(x) * 2;
+    CHECK_EQ(out[2], 6.0);
+    y = F<math::log>(F<math::exp>(x));
+    CHECK(std::fabs(out[1] - 4) < 1e-15);
+}
+
+int main() {
+    test_accurate<float>();
+    test_accurate<double>();
+    test_fast<float>({64, 64, 128, 64, 128, 32});
+    test_fast<double>({1 << 17, 1 << 19, 1 << 18, 1 << 17, 1 << 19, 1 << 14});
+    test_special<float>();
+    test_special<double>();
+    test_expression();
+
+    return 0;
+}
@@ -0,0 +1,76 @@
+#define MOU_ENABLE_MEMORY_TRACKING
+#include "../include/mou/logger.h"
+#include "../include/mou/memory.h"
+#include "../include/mou/tensor.h"
+#include <iostream>
+#include <thread>
+
+using namespace mou;
+using namespace mou::tensor;
+
+void test_Accounting() {
+    auto base = memory::TakeSnapshot();
+    auto live = base.live.size();
+    auto current = base.Current(device::cpu);
+    const int64_t a_bytes = 256 * sizeof(float);
+    const int64_t b_bytes = 1024 * sizeof(int);
+
+    Tensor<float> a(Shape(16, 16));
+    {
+        MOU_MEMORY_TAG("scratch");
+        Tensor<int> b(Shape(1024));
+        auto snap = memory::TakeSnapshot();
+        CHECK_EQ(snap.live.size(), live + 2);
+        CHECK_EQ(snap.Current(device::cpu), current + a_bytes + b_bytes);
+
+        // the largest one comes first
+        CHECK_EQ(snap.live[0].bytes, 1024 * sizeof(int));
+        CHECK_EQ(std::string(snap.live[0].tag), "scratch");
+        CHECK_EQ(snap.live[0].dims, 1);
+        CHECK_EQ(snap.live[0].shape[0], 1024);
+        CHECK_EQ(snap.live[1].tag, nullptr);
+        CHECK_EQ(snap.live[1].dims, 2);
+    }
+
+    auto snap = memory::TakeSnapshot();
+    CHECK_EQ(snap.live.size(), live + 1);
+    CHECK_EQ(snap.Current(device::cpu), current + a_bytes);
+    CHECK_GE(snap.Peak(device::cpu), current + a_bytes + b_bytes);
+
+    bool found = false;
+    for (auto& p : snap.allocators) {
+        if (p.allocator.find("std::allocator<float>") != std::string::npos) {
+            found = true;
+            CHECK_GE(p.allocations, 1);
+        }
+    }
+    CHECK(found);
+}
+
+void test_Threads() {
+    auto current = memory::TakeSnapshot().Current(device::cpu);
+
+    // many small allocations are batched per thread, the exiting thread
+    // publishes whatever is left
+    std::thread t([] {
+        for (int i = 0; i < 1000; ++i) {
+            Tensor<char> c(Shape(10));
+        }
+        Tensor<double> d(Shape(1 << 14));
+        auto snap = memory::TakeSnapshot();
+        CHECK_GE(snap.Peak(device::cpu),
+                 static_cast<int64_t>((1 << 14) * sizeof(double)));
+    });
+    t.join();
+
+    auto snap = memory::TakeSnapshot();
+    CHECK_EQ(snap.Current(device::cpu), current);
+    memory::WriteReport(std::cout, snap);
+}
+
+int main() {
+    test_Accounting();
+    test_Threads();
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include "../include/mou/logger.h"
+#include "../include/mou/numa.h"
+#include "../include/mou/tensor.h"
+#include <iostream>
+#include <sys/mman.h>
+
+using namespace mou;
+using namespace mou::tensor;
+
+void test_Topology() {
+    CHECK_GE(numa::NumNodes(), 1);
+    CHECK_EQ(numa::NodeOfWorker(0, 4), numa::NodeOfWorker(0, 1));
+    std::cout << "nodes: " << numa::NumNodes() << std::endl;
+}
+
+void test_Place() {
+    size_t bytes = 64 << 12;
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    CHECK(p != MAP_FAILED);
+
+    auto before = numa::NodeBytes();
+    numa::Place(p, bytes, numa::policy::partitioned, sizeof(float));
+    auto after = numa::NodeBytes();
+    int64_t added = 0;
+    for (size_t n = 0; n < after.size(); ++n) {
+        added += after[n] - (n < before.size() ? before[n] : 0);
+    }
+    CHECK_EQ(added, static_cast<int64_t>(bytes));
+
+    // parts cover the buffer exactly once
+    size_t covered = 0;
+    numa::ForEachPart(p, bytes, sizeof(float),
+                      [&](size_t, void*, size_t len, size_t) {
+        covered += len;
+    });
+    CHECK_EQ(covered, bytes);
+
+    std::fill(static_cast<char*>(p), static_cast<char*>(p) + bytes, 1);
+    size_t pages = 0;
+    for (auto c : numa::ResidentPages(p, bytes)) pages += c;
+    std::cout << "resident pages: " << pages << std::endl;
+    munmap(p, bytes);
+}
+
+void test_Tensor() {
+    using numa_tensor = Tensor<float, device::cpu, 0,
+                               numa::numa_allocator<float> >;
+    // constructors initialize in parallel
+    numa_tensor a(Shape(1 << 20));
+    CHECK_EQ(a[0], 0.f);
+    CHECK_EQ(a[(1 << 20) - 1], 0.f);
+
+    a = 3;
+    numa_tensor b(a);
+    CHECK_EQ(b[12345], 3.f);
+    b = b * 2;
+    CHECK_EQ(b[(1 << 20) - 1], 6.f);
+
+    Tensor<float, device::cpu, 0,
+           numa::numa_allocator<float, numa::policy::interleave> > c(Shape(16));
+    c = 1;
+    CHECK_EQ(c[15], 1.f);
+}
+
+int main() {
+    test_Topology();
+    test_Place();
+    test_Tensor();
+
+    return 0;
+}
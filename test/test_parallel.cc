@@ -0,0 +1,60 @@
+#include "../include/mou/logger.h"
+#include "../include/mou/parallel.h"
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+using namespace mou;
+using namespace mou::parallel;
+
+void test_ParallelFor() {
+    std::vector<int> v(100000, 0);
+    ParallelFor(0, v.size(), 1000, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i) v[i] += 1;
+    });
+    long sum = 0;
+    for (auto x : v) sum += x;
+    CHECK_EQ(sum, 100000);
+
+    // nested loops must not dead-lock
+    std::atomic<long> count{0};
+    ParallelFor(0, 64, 1, [&](size_t, size_t) {
+        ParallelFor(0, 1000, 10, [&](size_t b, size_t e) {
+            count += e - b;
+        });
+    });
+    CHECK_EQ(count, 64000);
+
+    bool thrown = false;
+    try {
+        ParallelFor(0, 100, 1, [](size_t b, size_t) {
+            if (b == 42) throw std::runtime_error("42");
+        });
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+void test_ParallelForStatic() {
+    ThreadPool pool(4);
+    std::vector<int> owner(1003, -1);
+    ParallelForStatic(0, owner.size(), [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i) owner[i] = ThreadPool::WorkerIndex();
+    }, pool);
+
+    // part k is always run by worker k
+    for (size_t k = 0; k < 4; ++k) {
+        auto range = StaticPartition(0, owner.size(), k, 4);
+        CHECK_EQ(owner[range.first], static_cast<int>(k));
+        CHECK_EQ(owner[range.second - 1], static_cast<int>(k));
+    }
+    CHECK_EQ(StaticPartition(0, 1003, 3, 4).second, 1003);
+}
+
+int main() {
+    test_ParallelFor();
+    test_ParallelForStatic();
+
+    return 0;
+}
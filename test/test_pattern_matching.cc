@@ -1,4 +1,7 @@
+#include "../include/mou/logger.h"
 #include "../include/mou/pattern_matching.h"
+#include <atomic>
+#include <cmath>
 #include <iostream>
 #include <string>
 #include <variant>
@@ -6,7 +9,7 @@
 
 using namespace mou::pm;
 
-int main() {
+void test_overloaded() {
     using var_t = std::variant<int, long, double, std::string, unsigned int>;
     std::vector<var_t> vec = {10, 15l, 1.5, "hello", 3u};
     for (auto& v: vec) {
@@ -18,5 +21,163 @@ int main() {
             [](auto arg) { std::cout << "auto::" << arg << '\n'; },
         }, v);
     }
+}
+
+void test_visit_all() {
+    using var_t = std::variant<int, long, double, std::string, unsigned int>;
+    std::vector<var_t> vec;
+    for (int i = 0; i < 20000; ++i) {
+        switch (i % 5) {
+            case 0: vec.emplace_back(i); break;
+            case 1: vec.emplace_back(2l); break;
+            case 2: vec.emplace_back(0.5); break;
+            case 3: vec.emplace_back(std::string("ab")); break;
+            case 4: vec.emplace_back(1u); break;
+        }
+    }
+
+    for (auto mode : {dispatch::sequential, dispatch::bucketed,
+                      dispatch::parallel}) {
+        std::atomic<long> ints{0}, longs{0}, strings{0}, others{0};
+        match(vec, mode,
+            [&](int arg) { ints += arg; },
+            [&](long arg) { longs += arg; },
+            [&](const std::string& arg) { strings += arg.size(); },
+            [&](auto) { others += 1; });
+        CHECK_EQ(ints, 39990000);
+        CHECK_EQ(longs, 8000);
+        CHECK_EQ(strings, 8000);
+        CHECK_EQ(others, 8000);
+    }
+
+    // sequential dispatch keeps range order and may mutate
+    std::vector<std::variant<int, double> > small = {1, 2.5, 3};
+    std::vector<double> seen;
+    visit_all([&](auto& v) { seen.push_back(v); v *= 2; }, small);
+    CHECK_EQ(seen.size(), 3);
+    CHECK_EQ(seen[1], 2.5);
+    CHECK_EQ(std::get<int>(small[2]), 6);
+}
+
+// a visitor may visit another, larger range of the same type bucketed
+void test_visit_nested() {
+    using var_t = std::variant<int, double>;
+    std::vector<var_t> outer = {1, 2.0, 3};
+    std::vector<var_t> inner(10000, var_t(1));
+    long total = 0;
+    visit_all([&](auto v) {
+        total += static_cast<long>(v);
+        visit_all([&](auto w) { total += static_cast<long>(w); }, inner,
+                  dispatch::bucketed);
+    }, outer, dispatch::bucketed);
+    CHECK_EQ(total, 6 + 3 * 10000);
+}
+
+struct header {
+    int kind;
+    int code;
+};
+
+struct message {
+    header head;
+    int route;
+    std::string body;
+};
+
+void test_match_value() {
+    auto name = [](int x) {
+        return match(x,
+            case_(lit<1>, [] { return std::string("one"); }),
+            case_(lit<2>, [] { return std::string("two"); }),
+            case_(when([](int v) { return v < 0; }),
+                  [] { return std::string("negative"); }),
+            case_(lit<100>, [] { return std::string("hundred"); }),
+            case_(_, [](int v) { return std::to_string(v); }));
+    };
+    CHECK_EQ(name(1), "one");
+    CHECK_EQ(name(2), "two");
+    CHECK_EQ(name(-5), "negative");
+    CHECK_EQ(name(100), "hundred");
+    CHECK_EQ(name(7), "7");
+
+    // the guard case between lit<2> and lit<100> keeps its priority
+    CHECK_EQ(match(-3,
+        case_(when([](int v) { return v < 0; }), [] { return 0; }),
+        case_(lit<-3>, [] { return 1; })), 0);
+
+    // floating-point subjects are tested case by case, never converted
+    auto real = [](double d) {
+        return match(d,
+            case_(lit<1>, [] { return 1; }),
+            case_(lit<2>, [] { return 2; }),
+            case_(_, [] { return 0; }));
+    };
+    CHECK_EQ(real(2.0), 2);
+    CHECK_EQ(real(2.5), 0);
+    CHECK_EQ(real(std::nan("")), 0);
+    CHECK_EQ(real(1e300), 0);
+    CHECK_EQ(match(std::pair<int, double>(1, 1.0),
+        case_(ds(_, lit<1>), [] { return 1; }),
+        case_(_, [] { return 0; })), 1);
+
+    bool thrown = false;
+    try {
+        match(3, case_(lit<1>, [] { return 1; }));
+    } catch (const no_match&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+void test_match_structure() {
+    auto route = [](const message& m) {
+        return match(m,
+            case_(ds(ds(lit<1>, lit<200>), _, _), [] { return 0; }),
+            case_(ds(ds(lit<1>, _), lit<7>, _), [] { return 1; }),
+            case_(ds(_, val(9), when([](const std::string& s) {
+                      return s.empty(); })), [] { return 2; }),
+            case_(ds(ds(lit<2>, _), _, _),
+                  [](const message& m) { return m.route > 0; },
+                  [](const header& h, int, const std::string&) {
+                      return 10 + h.code;
+                  }),
+            case_(_, [] { return -1; }));
+    };
+    CHECK_EQ(route(message{{1, 200}, 0, "x"}), 0);
+    CHECK_EQ(route(message{{1, 404}, 7, "x"}), 1);
+    CHECK_EQ(route(message{{1, 404}, 9, ""}), 2);
+    CHECK_EQ(route(message{{3, 404}, 9, ""}), 2);
+    CHECK_EQ(route(message{{2, 5}, 1, "x"}), 15);
+    CHECK_EQ(route(message{{2, 5}, 0, "x"}), -1);
+
+    // discriminant on a field, keys far apart use a binary search
+    auto sparse = [](std::pair<int, int> p) {
+        return match(p,
+            case_(ds(_, lit<-1000000>), [] { return 1; }),
+            case_(ds(_, lit<0>), [] { return 2; }),
+            case_(ds(lit<5>, _), [] { return 3; }),
+            case_(ds(_, lit<1000000>), [] { return 4; }),
+            case_(_, [] { return 0; }));
+    };
+    CHECK_EQ(sparse({5, 1000000}), 3);
+    CHECK_EQ(sparse({4, 1000000}), 4);
+    CHECK_EQ(sparse({4, -1000000}), 1);
+    CHECK_EQ(sparse({4, 0}), 2);
+    CHECK_EQ(sparse({4, 1}), 0);
+
+    int hits = 0;
+    match(message{{1, 1}, 1, ""},
+        case_(ds(ds(lit<1>, _), _, _), [&] { ++hits; }),
+        case_(_, [&] { hits += 10; }));
+    CHECK_EQ(hits, 1);
+}
+
+int main() {
+    test_overloaded();
+    test_visit_all();
+    test_visit_nested();
+    test_match_value();
+    test_match_structure();
+
     return 0;
 }
@@ -0,0 +1,87 @@
+#define MOU_ENABLE_PROFILER
+#include "../include/mou/logger.h"
+#include "../include/mou/profiler.h"
+#include "../include/mou/tensor.h"
+#include <atomic>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+using namespace mou;
+using namespace mou::tensor;
+
+void test_Tensor_counters() {
+    profiler::Reset();
+
+    Tensor<int> a(Shape(2, 3));
+    a = 1;
+    Tensor<int> b(a);
+    auto c = b.Slice(0, 1);
+
+    auto snap = profiler::Collect();
+    // a, b and c
+    CHECK_EQ(snap[profiler::op::allocate].calls, 3);
+    CHECK_EQ(snap[profiler::op::allocate].bytes, 15 * sizeof(int));
+    CHECK_EQ(snap[profiler::op::eval].elements, 6);
+    CHECK_EQ(snap[profiler::op::copy].bytes, 6 * sizeof(int));
+    CHECK_EQ(snap[profiler::op::slice].calls, 1);
+    CHECK_EQ(snap[profiler::op::slice].bytes, 3 * sizeof(int));
+}
+
+void test_Threads() {
+    profiler::Reset();
+
+    auto work = [] {
+        MOU_PROFILE_REGION("worker");
+        Tensor<float> t(Shape(100));
+        t = 2;
+    };
+    std::thread t1(work), t2(work);
+    t1.join();
+    t2.join();
+    {
+        MOU_PROFILE_REGION("worker");
+    }
+
+    // exited threads are kept in the report
+    auto snap = profiler::Collect();
+    CHECK_EQ(snap.regions["worker"].calls, 3);
+    CHECK_EQ(snap[profiler::op::eval].elements, 200);
+    CHECK_EQ(snap[profiler::op::deallocate].bytes, 200 * sizeof(float));
+
+    std::ostringstream json;
+    profiler::WriteJson(json, snap);
+    CHECK(json.str().find("\"worker\":{\"calls\":3") != std::string::npos);
+    std::cout << json.str() << std::endl;
+    profiler::WriteText(std::cout, snap);
+
+    profiler::Reset();
+    CHECK_EQ(profiler::Collect().regions["worker"].calls, 0);
+}
+
+// a reset while another thread is counting is never overwritten by it
+void test_ResetWhileRunning() {
+    profiler::Reset();
+    std::atomic<bool> stop{false};
+    uint64_t total = 0;
+    std::thread t([&] {
+        while (!stop.load()) {
+            MOU_PROFILE_REGION("busy");
+            ++total;
+        }
+    });
+    uint64_t before = 0;
+    while (before < 10000) before = profiler::Collect().regions["busy"].calls;
+    profiler::Reset();
+    stop = true;
+    t.join();
+    CHECK_LE(profiler::Collect().regions["busy"].calls, total - before);
+}
+
+int main() {
+    test_Tensor_counters();
+    test_Threads();
+    test_ResetWhileRunning();
+
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include "../include/mou/reflection.h"
 #include <cassert>
+#include <string>
+#include <vector>
 
 using namespace mou::reflection;
 
@@ -8,6 +10,25 @@ struct sc {
     char b;
 };
 
+struct nested {
+    sc inner;
+    std::vector<int> v;
+    std::string s;
+};
+
+struct wide {
+    int f0, f1, f2, f3, f4, f5, f6, f7, f8, f9;
+    int f10, f11, f12, f13, f14, f15, f16, f17, f18, f19;
+    int f20, f21, f22, f23, f24, f25, f26, f27, f28, f29;
+    int f30, f31, f32, f33, f34, f35, f36, f37, f38, f39;
+    int f40, f41, f42, f43, f44, f45, f46, f47, f48, f49;
+    int f50, f51, f52, f53, f54, f55, f56, f57, f58, f59;
+    int f60, f61, f62;
+    double f63;
+};
+
+struct empty {};
+
 int main() {
     sc s { 1, 'a' };
     auto ts = tuple_binding(s);
@@ -15,5 +36,43 @@ int main() {
     assert(std::get<0>(ts) == 1);
     assert(std::get<1>(ts) == 'a');
 
+    static_assert(field_count_v<sc> == 2);
+    static_assert(field_count_v<const sc> == 2);
+    static_assert(field_count_v<nested> == 3);
+    static_assert(field_count_v<wide> == 64);
+    static_assert(field_count_v<empty> == 0);
+    static_assert(field_count_v<int> == 0);
+
+    // references, no copies
+    auto ref = tie_binding(s);
+    static_assert(std::is_same_v<decltype(ref), std::tuple<int&, char&>>);
+    std::get<0>(ref) = 2;
+    assert(s.a == 2);
+
+    const sc& cs = s;
+    static_assert(std::is_same_v<decltype(tie_binding(cs)),
+                                 std::tuple<const int&, const char&>>);
+    static_assert(std::is_same_v<decltype(ctie_binding(s)),
+                                 std::tuple<const int&, const char&>>);
+
+    nested n { {3, 'b'}, {1, 2, 3}, "hello" };
+    auto& v = std::get<1>(tie_binding(n));
+    assert(&v == &n.v);
+    static_assert(std::is_same_v<field_t<2, nested>, std::string>);
+
+    // fields of an rvalue are moved into the tuple
+    auto moved = tuple_binding(std::move(n));
+    assert(std::get<1>(moved).size() == 3);
+    assert(n.v.empty());
+
+    wide w {};
+    w.f63 = 1.5;
+    assert(std::get<63>(tie_binding(w)) == 1.5);
+
+    int sum = 0;
+    sc t { 4, 5 };
+    for_each_field(t, [&sum](auto& f) { sum += f; });
+    assert(sum == 9);
+
     return 0;
 }
@@ -0,0 +1,189 @@
+#include "../include/mou/logger.h"
+#include "../include/mou/serialization.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace mou;
+using namespace mou::serialization;
+using namespace mou::tensor;
+
+struct point {
+    float x, y;
+};
+
+struct padded {
+    char c;
+    int i;
+};
+
+enum class color : char { red, green };
+
+struct header {
+    int id;
+    short kind;
+    short flags;
+    color c;
+};
+
+struct message {
+    header head;
+    std::vector<point> path;
+    std::string name;
+    double score;
+    std::vector<std::string> tags;
+};
+
+struct flagged {
+    int id;
+    bool on;
+};
+
+struct with_tensor {
+    int step;
+    Tensor<float> weights;
+};
+
+void test_Traits() {
+    static_assert(is_packed_v<int>);
+    static_assert(is_packed_v<point>);
+    static_assert(!is_packed_v<padded>);
+    static_assert(!is_packed_v<message>);
+
+    static_assert(static_size_v<point> == 8);
+    // padding is not part of the encoding
+    static_assert(static_size_v<padded> == 5);
+    static_assert(static_size_v<header> == 9);
+    static_assert(static_size_v<message> == 0);
+}
+
+void test_RoundTrip() {
+    message m { {7, 2, 3, color::green}, {{0, 1}, {2, 3}, {4, 5}}, "route",
+                0.5, {"a", "bc"} };
+    auto buf = Encode(m);
+    CHECK_EQ(buf.size(), EncodedSize(m));
+    CHECK_EQ(buf.size(), 9 + (8 + 24) + (8 + 5) + 8 + (8 + 8 + 1 + 8 + 2));
+
+    auto n = Decode<message>(buf);
+    CHECK_EQ(n.head.id, 7);
+    CHECK_EQ(n.head.flags, 3);
+    CHECK(n.head.c == color::green);
+    CHECK_EQ(n.path.size(), 3);
+    CHECK_EQ(n.path[2].y, 5);
+    CHECK_EQ(n.name, "route");
+    CHECK_EQ(n.score, 0.5);
+    CHECK_EQ(n.tags[1], "bc");
+
+    padded p { 'x', 42 };
+    auto q = Decode<padded>(Encode(p));
+    CHECK_EQ(q.c, 'x');
+    CHECK_EQ(q.i, 42);
+
+    // several values appended to one buffer
+    std::vector<char> stream;
+    Encode(p, stream);
+    Encode(std::string("tail"), stream);
+    padded r;
+    std::string s;
+    auto pos = DecodeFrom(stream.data(), stream.data() + stream.size(), r);
+    DecodeFrom(pos, stream.data() + stream.size(), s);
+    CHECK_EQ(r.i, 42);
+    CHECK_EQ(s, "tail");
+}
+
+void test_Tensor() {
+    with_tensor w { 3, Tensor<float>(Shape(2, 3)) };
+    for (size_t i = 0; i < w.weights.Size(); ++i) {
+        w.weights[i] = i * 0.5f;
+    }
+    auto buf = Encode(w);
+    CHECK_EQ(buf.size(), 4 + 8 * 3 + 6 * sizeof(float));
+
+    auto v = Decode<with_tensor>(buf);
+    CHECK_EQ(v.step, 3);
+    CHECK_EQ(v.weights.Shape_(), Shape(2, 3));
+    CHECK_EQ(v.weights[5], 2.5f);
+}
+
+void test_Truncated() {
+    message m { {1, 0, 0, color::red}, {{1, 2}}, "x", 1, {} };
+    auto buf = Encode(m);
+    bool thrown = false;
+    try {
+        Decode<message>(buf.data(), buf.size() - 1);
+    } catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+// corrupt tensor headers are rejected before anything is allocated
+void test_CorruptTensor() {
+    with_tensor w { 3, Tensor<float>(Shape(2, 3)) };
+    auto buf = Encode(w);
+    // dims at offset 4, then the sizes; the last one overflows 2 * size
+    const uint64_t bad[][2] = {
+        {4, uint64_t(1) << 40}, {12, uint64_t(1) << 62}, {20, uint64_t(1) << 63}};
+    for (auto& b : bad) {
+        auto copy = buf;
+        std::memcpy(copy.data() + b[0], &b[1], sizeof(uint64_t));
+        bool thrown = false;
+        try {
+            Decode<with_tensor>(copy);
+        } catch (const std::out_of_range&) {
+            thrown = true;
+        }
+        CHECK(thrown);
+    }
+}
+
+template <typename T>
+bool rejects(const std::vector<char>& buf) {
+    try {
+        Decode<T>(buf);
+    } catch (const std::out_of_range&) {
+        return true;
+    }
+    return false;
+}
+
+// lengths are checked before allocating, whatever the element type
+void test_CorruptLength() {
+    std::vector<char> buf(9, 0);
+    const uint64_t huge = uint64_t(1) << 40;
+    std::memcpy(buf.data(), &huge, sizeof(huge));
+    CHECK(rejects<std::vector<std::string> >(buf));
+    CHECK(rejects<std::vector<std::vector<int> > >(buf));
+    CHECK(rejects<std::vector<message> >(buf));
+
+    // n * sizeof(CharT) would overflow to a small size
+    const uint64_t wrap = (uint64_t(1) << 62) + 1;
+    std::memcpy(buf.data(), &wrap, sizeof(wrap));
+    buf.resize(8 + 4 * 4);
+    CHECK(rejects<std::u32string>(buf));
+}
+
+void test_Bool() {
+    static_assert(!is_packed_v<bool>);
+    static_assert(static_size_v<flagged> == 5);
+    auto buf = Encode(flagged{7, true});
+    auto f = Decode<flagged>(buf);
+    CHECK_EQ(f.id, 7);
+    CHECK(f.on);
+
+    buf.back() = 2;
+    CHECK(rejects<flagged>(buf));
+}
+
+int main() {
+    test_Traits();
+    test_RoundTrip();
+    test_Tensor();
+    test_Truncated();
+    test_CorruptTensor();
+    test_CorruptLength();
+    test_Bool();
+
+    return 0;
+}
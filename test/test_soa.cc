@@ -0,0 +1,69 @@
+#include "../include/mou/logger.h"
+#include "../include/mou/soa.h"
+#include <cstdint>
+#include <vector>
+
+using namespace mou;
+using namespace mou::expr;
+using namespace mou::soa;
+
+struct particle {
+    float x;
+    float v;
+    double mass;
+    int id;
+};
+
+void test_Conversion() {
+    std::vector<particle> aos;
+    for (int i = 0; i < 1000; ++i) {
+        aos.push_back(particle{i * 1.f, i * 0.5f, i * 2.0, i});
+    }
+
+    auto soa = SoAVector<particle>::FromAoS(aos.data(), aos.size());
+    CHECK_EQ(soa.Size(), 1000);
+    CHECK_EQ(soa.Data<0>()[10], 10.f);
+    CHECK_EQ(soa.Data<3>()[999], 999);
+    CHECK_EQ(reinterpret_cast<uintptr_t>(soa.Data<2>()) % kColumnAlignment, 0);
+
+    std::vector<particle> back(soa.Size());
+    soa.ToAoS(back.data());
+    CHECK_EQ(back[500].mass, 1000.0);
+    CHECK_EQ(back[500].id, 500);
+}
+
+void test_Columns() {
+    SoAVector<particle> soa;
+    for (int i = 0; i < 40; ++i) {
+        soa.PushBack(particle{1.f * i, 2.f, 1.0, i});
+    }
+
+    // x += v * dt, over whole columns
+    auto x = soa.Column<0>();
+    x = F<axpy>(soa.Column<1>(), soa.Column<1>(), x);
+    CHECK_EQ(soa.Data<0>()[7], 11.f);
+
+    particle p = soa[7];
+    CHECK_EQ(p.x, 11.f);
+    CHECK_EQ(p.id, 7);
+
+    soa[7].get<3>() = -1;
+    CHECK_EQ(soa.Get(7).id, -1);
+    soa[8] = particle{0, 0, 0, 42};
+    CHECK_EQ(soa.Data<3>()[8], 42);
+    soa[9] = soa[8];
+    CHECK_EQ(soa.Data<3>()[9], 42);
+
+    SoAVector<particle> copy(soa);
+    copy.Resize(50);
+    CHECK_EQ(copy.Data<3>()[49], 0);
+    CHECK_EQ(copy.Data<3>()[9], 42);
+    CHECK_EQ(soa.Size(), 40);
+}
+
+int main() {
+    test_Conversion();
+    test_Columns();
+
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "../include/mou/logger.h"
+#include "../include/mou/static_tensor.h"
+#include "../include/mou/tensor.h"
+#include <stdexcept>
+#include <type_traits>
+
+using namespace mou;
+using namespace mou::tensor;
+
+void test_Layout() {
+    using mat3 = StaticTensor<float, 3, 3>;
+    using mat4 = StaticTensor<float, 4, 4>;
+    static_assert(mat3::kSize == 9 && mat3::kDims == 2);
+    static_assert(sizeof(mat3) == 9 * sizeof(float));
+    static_assert(sizeof(mat4) == 16 * sizeof(float));
+    static_assert(alignof(mat4) == kStaticAlignment);
+    static_assert(std::is_trivially_copyable_v<mat4>);
+
+    constexpr StaticTensor<int, 2, 3> c{1, 2, 3, 4, 5, 6};
+    static_assert(c(1, 2) == 6 && c[3] == 4);
+
+    // lists of the wrong length are rejected
+    bool thrown = false;
+    try {
+        StaticTensor<int, 2> d{1, 2, 3};
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+void test_Expression() {
+    StaticTensor<float, 16> a, b;
+    CHECK_EQ(a[15], 0.f);
+    a = 2;
+    b = a * 3 + 1;
+    CHECK_EQ(b[0], 7.f);
+    CHECK_EQ(b[15], 7.f);
+
+    // mixed with a heap tensor of the same size
+    Tensor<float> t(Shape(16));
+    t = b - a;
+    CHECK_EQ(t[8], 5.f);
+    a = t * b;
+    CHECK_EQ(a[3], 35.f);
+
+    StaticTensor<float, 4, 4> m = a + 1;
+    CHECK_EQ(m(3, 3), 36.f);
+
+    // large shapes take the loop
+    StaticTensor<double, 300> big;
+    big = 1.5;
+    CHECK_EQ(Dot(big, big), 300 * 2.25);
+}
+
+template <typename T, size_t M, size_t K, size_t N>
+void check_MatMul(const StaticTensor<T, M, K>& a,
+                  const StaticTensor<T, K, N>& b) {
+    auto c = MatMul(a, b);
+    for (size_t i = 0; i < M; ++i) {
+        for (size_t j = 0; j < N; ++j) {
+            T sum = 0;
+            for (size_t k = 0; k < K; ++k) sum += a(i, k) * b(k, j);
+            CHECK_EQ(c(i, j), sum);
+        }
+    }
+}
+
+void test_MatMul() {
+    StaticTensor<int, 3, 3> r{0, -1, 0,
+                              1,  0, 0,
+                              0,  0, 1};
+    StaticTensor<int, 3> p{1, 2, 3};
+    auto q = MatMul(r, p);
+    CHECK_EQ(q[0], -2);
+    CHECK_EQ(q[1], 1);
+    CHECK_EQ(q[2], 3);
+    CHECK_EQ(Dot(p, p), 14);
+
+    StaticTensor<int, 4, 4> a, b;
+    for (size_t i = 0; i < 16; ++i) {
+        a[i] = static_cast<int>(i);
+        b[i] = static_cast<int>(16 - i);
+    }
+    check_MatMul(a, b);
+    check_MatMul(r, r);
+
+    StaticTensor<int, 2, 5> x;
+    StaticTensor<int, 5, 3> y;
+    x = 2;
+    y = 3;
+    check_MatMul(x, y);
+
+    StaticTensor<long, 8, 16> u;
+    StaticTensor<long, 16, 8> v;
+    u = 1;
+    v = 2;
+    check_MatMul(u, v);
+}
+
+int main() {
+    test_Layout();
+    test_Expression();
+    test_MatMul();
+
+    return 0;
+}
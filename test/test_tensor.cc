@@ -39,6 +39,38 @@ void test_Shape() {
 
     s3 = {};
     CHECK_EQ(s3.Dims(), 0);
+
+    // strides are row-major
+    CHECK_EQ(s1.Stride(0), 12);
+    CHECK_EQ(s1.Stride(1), 4);
+    CHECK_EQ(s1.Stride(2), 1);
+    CHECK_EQ(s1.SizeFrom(1), 12);
+    CHECK_EQ(s1.With(0, 5), Shape(5, 3, 4));
+    CHECK_EQ(s1.Size(), 24);
+
+    // more than kInlineDims dimensions go to the heap
+    Shape s4(1, 2, 1, 2, 1, 2, 1, 2, 1, 2);
+    CHECK_EQ(s4.Dims(), 10);
+    CHECK_EQ(s4.Size(), 32);
+    CHECK_EQ(s4.Stride(0), 32);
+    Shape s5(s4);
+    CHECK_EQ(s5, s4);
+    Shape s6(std::move(s5));
+    CHECK_EQ(s6, s4);
+    s5 = s1;
+    CHECK_EQ(s5, s1);
+    s6 = std::move(s5);
+    CHECK_EQ(s6, s1);
+    s6 = s4;
+    CHECK_EQ(s6.With(9, 3).Size(), 48);
+
+    bool thrown = false;
+    try {
+        s1[3];
+    } catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    CHECK(thrown);
 }
 
 void test_Tensor() {
@@ -119,10 +151,30 @@ void test_Tensor_format() {
     std::cout << e << std::endl;
 }
 
+// only opted-in allocators evaluate large expressions on the pool
+void test_Tensor_parallel() {
+    static_assert(!parallel_eval<std::allocator<float> >::value, "");
+    static_assert(parallel_eval<parallel_allocator<float> >::value, "");
+
+    const size_t n = EvalParams().parallel_threshold * 4;
+    Tensor<float> a{Shape(n)};
+    Tensor<float, device::cpu, 0, parallel_allocator<float> > b{Shape(n)};
+    for (size_t i = 0; i < n; ++i) {
+        a[i] = static_cast<float>(i % 11);
+    }
+    b = a * a + 1.f;
+    bool same = true;
+    for (size_t i = 0; i < n; ++i) {
+        same = same && b[i] == a[i] * a[i] + 1.f;
+    }
+    CHECK(same);
+}
+
 int main() {
     test_Shape();
     test_Tensor();
     test_Tensor_format();
+    test_Tensor_parallel();
 
     return 0;
 }
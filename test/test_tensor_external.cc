@@ -0,0 +1,120 @@
+#include "../include/mou/logger.h"
+#include "../include/mou/tensor.h"
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace mou;
+using namespace mou::tensor;
+
+void test_Borrow() {
+    std::vector<float> buf(6, 1.f);
+    {
+        Tensor<float> x(buf.data(), Shape(2, 3), borrow);
+        CHECK(x.External());
+        CHECK_EQ(x.Data(), buf.data());
+
+        // expressions read and write the buffer in place
+        Tensor<float> y{Shape(2, 3)};
+        y = x * 2.f + 1.f;
+        CHECK_EQ(y[5], 3.f);
+        x = y - x;
+        CHECK_EQ(buf[0], 2.f);
+        CHECK_EQ(x.Data(), buf.data());
+
+        // copies own their memory
+        Tensor<float> z = x;
+        CHECK(!z.External());
+        CHECK(z.Data() != buf.data());
+        CHECK_EQ(z[4], 2.f);
+    }
+    // the buffer outlives the tensor
+    CHECK_EQ(buf[3], 2.f);
+}
+
+void test_Adopt() {
+    int released = 0;
+    auto deleter = [&released](double* p) {
+        ++released;
+        ::operator delete(p, std::align_val_t(kSimdAlignment));
+    };
+    auto make = [] {
+        return static_cast<double*>(::operator new(
+            1024 * sizeof(double), std::align_val_t(kSimdAlignment)));
+    };
+    {
+        Tensor<double> x(make(), Shape(1024), deleter);
+        CHECK(x.External());
+        CHECK(x.IsAligned());
+        x = 3.0;
+
+        // moves hand the buffer over, it is released once
+        Tensor<double> y = std::move(x);
+        CHECK(y.External());
+        CHECK(!x.External());
+        CHECK_EQ(y[1023], 3.0);
+        CHECK_EQ(released, 0);
+
+        // a new shape releases the buffer for an allocated one
+        Tensor<double> z{Shape(2)};
+        y = z;
+        CHECK_EQ(released, 1);
+        CHECK(!y.External());
+
+        Tensor<double> w(make(), Shape(1024), deleter);
+        w = Tensor<double>(make(), Shape(1024), deleter);
+        CHECK_EQ(released, 2);
+    }
+    CHECK_EQ(released, 3);
+}
+
+void test_Alignment() {
+    alignas(64) float buf[32] = {};
+    Tensor<float> a(buf, Shape(16), borrow);
+    Tensor<float> b(buf + 1, Shape(16), borrow);
+    CHECK(a.IsAligned());
+    CHECK(!b.IsAligned());
+    CHECK(b.IsAligned(alignof(float)));
+
+    // buffers misaligned for the element type are rejected
+    bool thrown = false;
+    try {
+        char* bytes = reinterpret_cast<char*>(buf) + 1;
+        Tensor<float> c(reinterpret_cast<float*>(bytes), Shape(4), borrow);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    thrown = false;
+    try {
+        Tensor<float> d(nullptr, Shape(4), borrow);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    Tensor<float> e(nullptr, Shape(0), borrow);
+    CHECK_EQ(e.Size(), 0u);
+}
+
+// large borrowed tensors are evaluated like allocated ones
+void test_Large() {
+    const size_t n = 1 << 20;
+    std::vector<float> in(n, 2.f), out(n);
+    Tensor<float> x(in.data(), Shape(n), borrow);
+    Tensor<float> y(out.data(), Shape(n), borrow);
+    y = x * x + 1.f;
+    CHECK_EQ(out[0], 5.f);
+    CHECK_EQ(out[n - 1], 5.f);
+}
+
+int main() {
+    test_Borrow();
+    test_Adopt();
+    test_Alignment();
+    test_Large();
+    return 0;
+}
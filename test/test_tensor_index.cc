@@ -0,0 +1,132 @@
+#include "../include/mou/logger.h"
+#include "../include/mou/tensor_index.h"
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace mou;
+using namespace mou::tensor;
+
+void test_Gather() {
+    Tensor<int> x(Shape(3, 4, 5));
+    for (size_t i = 0; i < x.Size(); ++i) x[i] = static_cast<int>(i);
+    Tensor<int64_t> ids{3, 0, 3};
+
+    auto g0 = Gather(x, Tensor<int>{2, 1}, 0);
+    CHECK(g0.Shape_() == Shape(2, 4, 5));
+    CHECK_EQ(g0[0], 40);
+    CHECK_EQ(g0[20], 20);
+
+    auto g1 = Gather(x, ids, 1);
+    CHECK(g1.Shape_() == Shape(3, 3, 5));
+    bool same = true;
+    for (size_t o = 0; o < 3; ++o) {
+        for (size_t j = 0; j < 3; ++j) {
+            for (size_t i = 0; i < 5; ++i) {
+                same = same && g1[(o * 3 + j) * 5 + i] ==
+                    x[(o * 4 + ids[j]) * 5 + i];
+            }
+        }
+    }
+    CHECK(same);
+
+    // into a preallocated destination, along the last axis
+    Tensor<int> g2(Shape(3, 4, 3));
+    Gather(g2, x, ids, 2);
+    CHECK_EQ(g2[0], 3);
+    CHECK_EQ(g2[1], 0);
+    CHECK_EQ(g2[g2.Size() - 1], 58);
+
+    bool thrown = false;
+    try {
+        Gather(x, Tensor<int>{0, 4}, 1);
+    } catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+// random rows of a table, many at a time
+void test_Embedding() {
+    parallel::ThreadPool pool(3);
+    const size_t rows = 5000, dim = 64, batch = 20000;
+    Tensor<float> table(Shape(rows, dim));
+    for (size_t i = 0; i < table.Size(); ++i) table[i] = i % 1013;
+    Tensor<int32_t> ids{Shape(batch)};
+    std::mt19937 gen(2);
+    for (size_t j = 0; j < batch; ++j) ids[j] = gen() % rows;
+
+    auto g = Gather(table, ids, 0, pool);
+    bool same = true;
+    for (size_t j = 0; j < batch; ++j) {
+        same = same && g[j * dim + 7] == table[ids[j] * dim + 7];
+    }
+    CHECK(same);
+
+    // every gathered row added back once per occurrence
+    Tensor<float> acc(Shape(rows, dim));
+    acc = 0;
+    Tensor<float> ones(Shape(batch, dim));
+    ones = 1;
+    ScatterAdd(acc, ids, ones, 0, pool);
+    std::vector<float> count(rows, 0);
+    for (size_t j = 0; j < batch; ++j) ++count[ids[j]];
+    same = true;
+    for (size_t r = 0; r < rows; ++r) {
+        same = same && acc[r * dim] == count[r] &&
+            acc[r * dim + dim - 1] == count[r];
+    }
+    CHECK(same);
+}
+
+void test_ScatterAdd() {
+    Tensor<int> dst(Shape(2, 3));
+    dst = 0;
+    Tensor<int> src{1, 2, 3, 4, 5, 6};
+    src.Reshape(2, 3);
+    ScatterAdd(dst, Tensor<int>{2, 0, 2}, src, 1);
+    CHECK_EQ(dst[0], 2);
+    CHECK_EQ(dst[1], 0);
+    CHECK_EQ(dst[2], 4);
+    CHECK_EQ(dst[5], 10);
+}
+
+void test_ConcatSplit() {
+    Tensor<double> x(Shape(4, 6, 2));
+    for (size_t i = 0; i < x.Size(); ++i) x[i] = i * 0.5;
+
+    for (size_t axis = 0; axis < 3; ++axis) {
+        size_t len = x.Shape_()[axis];
+        auto parts = Split(x, {len / 2, 0, len - len / 2}, axis);
+        CHECK_EQ(parts.size(), size_t(3));
+        CHECK_EQ(parts[1].Size(), size_t(0));
+        CHECK(parts[2].Shape_() == x.Shape_().With(axis, len - len / 2));
+
+        auto whole = Concat(parts, axis);
+        CHECK(whole.Shape_() == x.Shape_());
+        bool same = true;
+        for (size_t i = 0; i < x.Size(); ++i) same = same && whole[i] == x[i];
+        CHECK(same);
+    }
+
+    auto parts = Split(x, {1, 5}, 1);
+    CHECK_EQ(parts[0][0], 0.);
+    CHECK_EQ(parts[0][2], 6.);
+    CHECK_EQ(parts[1][0], 1.);
+
+    // preallocated destination, parts in a different order
+    Tensor<double> y(Shape(4, 6, 2));
+    Concat(y, {&parts[1], &parts[0]}, 1);
+    CHECK_EQ(y[0], 1.);
+    CHECK_EQ(y[10], 0.);
+}
+
+int main() {
+    test_Gather();
+    test_Embedding();
+    test_ScatterAdd();
+    test_ConcatSplit();
+
+    return 0;
+}
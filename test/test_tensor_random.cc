@@ -0,0 +1,89 @@
+#include "../include/mou/async.h"
+#include "../include/mou/logger.h"
+#include "../include/mou/tensor_random.h"
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+using namespace mou;
+using namespace mou::random;
+using namespace mou::tensor;
+
+// known answers of the Random123 reference implementation
+void test_Philox() {
+    using counter = Philox4x32::counter;
+    CHECK(Philox4x32::Generate({0, 0, 0, 0}, {0, 0}) ==
+          (counter{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}));
+    CHECK(Philox4x32::Generate({~0u, ~0u, ~0u, ~0u}, {~0u, ~0u}) ==
+          (counter{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}));
+    CHECK(Philox4x32::Generate({0x243f6a88, 0x85a308d3, 0x13198a2e,
+                                0x03707344}, {0xa4093822, 0x299f31d0}) ==
+          (counter{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}));
+}
+
+template <typename T>
+void check_Moments(const Tensor<T>& t, double mean, double var) {
+    double s = 0, s2 = 0;
+    for (size_t i = 0; i < t.Size(); ++i) {
+        s += t[i];
+        s2 += double(t[i]) * t[i];
+    }
+    double n = t.Size(), m = s / n, v = s2 / n - m * m;
+    CHECK(std::fabs(m - mean) < 5 * std::sqrt(var / n));
+    CHECK(std::fabs(v - var) < 0.02 * var);
+}
+
+void test_Distribution() {
+    const size_t n = 1 << 20;
+    Tensor<float> u{Shape(n)};
+    RandomUniform(u, 1, -2, 4);
+    check_Moments(u, 1, 3);
+    bool inside = true;
+    for (size_t i = 0; i < n; ++i) inside = inside && u[i] >= -2 && u[i] < 4;
+    CHECK(inside);
+
+    Tensor<double> g{Shape(n)};
+    RandomNormal(g, 2, 3, 0.5);
+    check_Moments(g, 3, 0.25);
+
+    // seeds give different streams
+    Tensor<double> h{Shape(n)};
+    RandomNormal(h, 3, 3, 0.5);
+    CHECK(g[0] != h[0] && g[n - 1] != h[n - 1]);
+}
+
+// element i does not depend on who computes it, or in which order
+void test_Reproducible() {
+    const size_t n = 100000;
+    auto e = Normal<float>(9) * 2 + Uniform<float>(10);
+    std::vector<float> serial(n), chunked(n);
+    expr::EvalRange(serial.data(), e, 0, n);
+
+    parallel::ThreadPool pool(3);
+    parallel::ParallelFor(0, n, 777, [&](size_t begin, size_t end) {
+        expr::EvalRange(chunked.data(), e, begin, end);
+    }, pool);
+    CHECK(serial == chunked);
+
+    Tensor<float> t{Shape(n)};
+    t = e;
+    CHECK(std::equal(serial.begin(), serial.end(), t.Data()));
+    CHECK_EQ(e.Eval(n - 1), serial[n - 1]);
+
+    // generated leaves read no memory
+    Tensor<float> a{Shape(n)};
+    a = 1;
+    int leaves = 0;
+    expr::ForEachLeaf((a + e).self(), [&](const auto&) { ++leaves; });
+    CHECK_EQ(leaves, 1);
+    async::EvalAsync(t, Uniform<float>(5) + a).wait();
+    CHECK_EQ(t[3], Uniform<float>(5).Eval(3) + 1);
+}
+
+int main() {
+    test_Philox();
+    test_Distribution();
+    test_Reproducible();
+
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "../include/mou/logger.h"
+#include "../include/mou/tensor_scan.h"
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+
+using namespace mou;
+using namespace mou::tensor;
+
+// serial scan along `axis` by index arithmetic
+template <template <typename> class OP, typename T>
+void check_Scan(const Tensor<T>& src, const Tensor<T>& dst, size_t axis) {
+    const Shape& shape = src.Shape_();
+    size_t stride = shape.Stride(axis), len = shape[axis];
+    bool same = true;
+    for (size_t i = 0; i < src.Size(); ++i) {
+        size_t k = i / stride % len;
+        T expect = k == 0 ? src[i] : OP<T>::Map(dst[i - stride], src[i]);
+        same = same && dst[i] == expect;
+    }
+    CHECK(same);
+    CHECK(dst.Shape_() == shape);
+}
+
+void test_Axes() {
+    Tensor<int> x(Shape(3, 4, 5));
+    for (size_t i = 0; i < x.Size(); ++i) x[i] = static_cast<int>(i % 7) - 3;
+
+    for (size_t axis = 0; axis < 3; ++axis) {
+        check_Scan<scan_sum>(x, Cumsum(x, axis), axis);
+        check_Scan<scan_prod>(x, Cumprod(x, axis), axis);
+        check_Scan<scan_max>(x, Cummax(x, axis), axis);
+    }
+
+    Tensor<int> v{1, 2, 3, 4};
+    auto s = Cumsum(v, 0);
+    CHECK_EQ(s[3], 10);
+    CHECK_EQ(Cumprod(v, 0)[3], 24);
+
+    bool thrown = false;
+    try {
+        Cumsum(v, 1);
+    } catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+// few long rows take the two-pass block scan
+void test_Blocks() {
+    parallel::ThreadPool pool(3);
+    std::mt19937 gen(1);
+
+    for (size_t inner : {1, 3}) {
+        Tensor<int64_t> x(Shape(2, 5 * kScanBlock + 17, inner));
+        for (size_t i = 0; i < x.Size(); ++i) x[i] = gen() % 201 - 100;
+        check_Scan<scan_sum>(x, Cumsum(x, 1, pool), 1);
+        check_Scan<scan_max>(x, Cummax(x, 1, pool), 1);
+    }
+
+    // integer-valued floats are summed exactly in any order
+    Tensor<float> f(Shape(3 * kScanBlock + 5));
+    f = 1;
+    auto s = Cumsum(f, 0, pool);
+    CHECK_EQ(s[f.Size() - 1], static_cast<float>(f.Size()));
+    check_Scan<scan_sum>(f, s, 0);
+
+    // many short rows are scanned independently
+    Tensor<double> m(Shape(kScanBlock, 4));
+    m = 0.5;
+    check_Scan<scan_sum>(m, Cumsum(m, 1, pool), 1);
+    check_Scan<scan_sum>(m, Cumsum(m, 0, pool), 0);
+}
+
+int main() {
+    test_Axes();
+    test_Blocks();
+
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include "../include/mou/logger.h"
+#include "../include/mou/tensor_sort.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace mou;
+using namespace mou::tensor;
+
+template <typename T>
+void check_Key() {
+    std::vector<T> v = {T(0), T(1), T(100), std::numeric_limits<T>::max()};
+    if constexpr (std::is_signed_v<T>) {
+        v.insert(v.begin(), {std::numeric_limits<T>::lowest(), T(-2)});
+    }
+    if constexpr (std::is_floating_point_v<T>) {
+        v.insert(v.begin(), -std::numeric_limits<T>::infinity());
+        v.insert(v.begin() + 3, T(-0.5));
+        v.push_back(std::numeric_limits<T>::infinity());
+    }
+    for (size_t i = 0; i < v.size(); ++i) {
+        CHECK_EQ(radix_key<T>::From(radix_key<T>::To(v[i])), v[i]);
+        if (i == 0) continue;
+        CHECK_LT(radix_key<T>::To(v[i - 1]), radix_key<T>::To(v[i]));
+    }
+}
+
+void test_Key() {
+    check_Key<int8_t>();
+    check_Key<uint16_t>();
+    check_Key<int32_t>();
+    check_Key<int64_t>();
+    check_Key<float>();
+    check_Key<double>();
+}
+
+// every row along `axis` against std::stable_sort
+template <typename T>
+void check_Sort(const Tensor<T>& x, size_t axis, bool descending,
+                parallel::ThreadPool& pool) {
+    auto s = Sort(x, axis, descending, pool);
+    auto a = ArgSort(x, axis, descending, pool);
+    const Shape& shape = x.Shape_();
+    size_t len = shape[axis], inner = shape.SizeFrom(axis + 1);
+    bool same = true;
+    std::vector<expr::index_t> idx(len);
+    for (size_t r = 0; r < x.Size() / len; ++r) {
+        size_t base = r / inner * len * inner + r % inner;
+        std::iota(idx.begin(), idx.end(), 0);
+        std::stable_sort(idx.begin(), idx.end(), [&](auto i, auto j) {
+            T a = x[base + i * inner], b = x[base + j * inner];
+            return descending ? b < a : a < b;
+        });
+        for (size_t k = 0; k < len; ++k) {
+            same = same && a[base + k * inner] == idx[k] &&
+                s[base + k * inner] == x[base + idx[k] * inner];
+        }
+    }
+    CHECK(same);
+}
+
+void test_Sort() {
+    parallel::ThreadPool pool(3);
+    std::mt19937_64 gen(3);
+
+    Tensor<int> small(Shape(4, 5, 6));
+    for (size_t i = 0; i < small.Size(); ++i) small[i] = gen() % 9 - 4;
+    for (size_t axis = 0; axis < 3; ++axis) {
+        check_Sort(small, axis, false, pool);
+        check_Sort(small, axis, true, pool);
+    }
+
+    // radix rows with repeated keys, many rows and a single long row
+    Tensor<float> f(Shape(37, 1000));
+    std::normal_distribution<float> normal;
+    for (size_t i = 0; i < f.Size(); ++i) {
+        // + 0 turns -0 into 0, which the comparison sort takes as equal
+        f[i] = std::round(normal(gen) * 100) / 8 + 0.f;
+    }
+    check_Sort(f, 1, false, pool);
+    check_Sort(f, 0, true, pool);
+    f.Reshape(f.Size());
+    check_Sort(f, 0, false, pool);
+
+    Tensor<int64_t> l(Shape(2, 50000));
+    for (size_t i = 0; i < l.Size(); ++i) l[i] = gen() >> (i % 64);
+    check_Sort(l, 1, false, pool);
+    check_Sort(l, 1, true, pool);
+
+    Tensor<uint8_t> b(Shape(300));
+    for (size_t i = 0; i < b.Size(); ++i) b[i] = gen() % 3;
+    check_Sort(b, 0, false, pool);
+
+    Tensor<double> d{2, -0.5, NAN, -INFINITY, 1e300, 0};
+    auto s = Sort(d, 0);
+    CHECK_EQ(s[0], -INFINITY);
+    CHECK_EQ(s[1], -0.5);
+    CHECK_EQ(s[4], 1e300);
+    CHECK(std::isnan(s[5]));
+}
+
+void test_TopK() {
+    parallel::ThreadPool pool(2);
+    std::mt19937 gen(5);
+
+    Tensor<int> x(Shape(20, 300));
+    for (size_t i = 0; i < x.Size(); ++i) x[i] = gen() % 50;
+
+    for (size_t k : {0, 1, 5, 100, 300}) {
+        auto [v, i] = TopK(x, k, 1, pool);
+        CHECK(v.Shape_() == Shape(20, k));
+        auto a = ArgSort(x, 1, true, pool);
+        bool same = true;
+        for (size_t r = 0; r < 20; ++r) {
+            for (size_t j = 0; j < k; ++j) {
+                same = same && i[r * k + j] == a[r * 300 + j] &&
+                    v[r * k + j] == x[r * 300 + i[r * k + j]];
+            }
+        }
+        CHECK(same);
+    }
+
+    // along the first axis
+    Tensor<float> c{3, 1, 4, 1, 5, 9, 2, 6};
+    c.Reshape(4, 2);
+    auto [v, i] = TopK(c, 2, 0, pool);
+    CHECK_EQ(v[0], 5.f);
+    CHECK_EQ(v[1], 9.f);
+    CHECK_EQ(i[2], 1);
+    CHECK_EQ(i[3], 3);
+
+    bool thrown = false;
+    try {
+        TopK(c, 5, 0);
+    } catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+int main() {
+    test_Key();
+    test_Sort();
+    test_TopK();
+
+    return 0;
+}